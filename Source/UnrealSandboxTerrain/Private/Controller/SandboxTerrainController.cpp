@@ -4,6 +4,8 @@
 
 #include "TerrainZoneComponent.h"
 #include "VoxelMeshComponent.h"
+#include "FarTerrainComponent.h"
+#include "TerrainBatchComponent.h"
 
 #include "TerrainServerComponent.h"
 #include "TerrainClientComponent.h"
@@ -11,6 +13,8 @@
 #include <cmath>
 #include <list>
 #include <bitset>
+#include <algorithm>
+#include <map>
 
 #include "Core/SandboxVoxelCore.h"
 #include "serialization.hpp"
@@ -26,6 +30,8 @@
 
 #include "UnrealSandboxData.h"
 
+static_assert(TConveyour::class_num == ConveyorTaskClassNum, "conveyor queue per task class");
+
 
 // ====================================
 // FIXME 
@@ -192,6 +198,9 @@ void ASandboxTerrainController::BeginPlay() {
 		}
 	}
 
+	bMaterialCreatedOnLoad = false;
+	PrepareTerrainMaterials();
+
 	if (!GetWorld()) return;
 	bIsLoadFinished = false;
 
@@ -245,6 +254,20 @@ void ASandboxTerrainController::EndPlay(const EEndPlayReason::Type EndPlayReason
     TerrainData->Clean();
 	GetTerrainGenerator()->Clean();
 
+	FarTerrainMap.Empty();
+	FarTerrainCache.Empty();
+	FarTerrainRequired.Empty();
+	FarTerrainPending.Empty();
+
+	ZoneBatchMap.Empty();
+	ZoneBatchRequired.Empty();
+	ZoneBatchPending.Empty();
+	ZoneBatchDirty.Empty();
+	ZoneBatchSwap.Empty();
+
+	OccludedZoneSet.Empty();
+	CollisionFocusList.Empty();
+
 	delete ThreadPool;
 	delete Conveyor;
 }
@@ -256,12 +279,52 @@ void ASandboxTerrainController::Tick(float DeltaTime) {
 
 	LoadConsoleVars();
 
+	// frame cap (t.MaxFPS, server tick rate) gives longer target. frame is not slow because of capped rate
+	double TargetFrameTime = ConveyorTargetFrameTime;
+	if (GEngine) {
+		const float MaxTickRate = GEngine->GetMaxTickRate(DeltaTime, false);
+		if (MaxTickRate > 0) {
+			TargetFrameTime = FMath::Max(TargetFrameTime, 1.0 / MaxTickRate);
+		}
+	}
+
+	// idle wait of frame rate limiter is not work
+	const double FrameWorkTime = FMath::Max(0.0, (double)DeltaTime - FApp::GetIdleTime());
+
+	// adapt budget to measured frame time: halve on slow frame, grow slowly otherwise
+	if (ConveyorBudget == 0) {
+		ConveyorBudget = FMath::Min(ConveyorMaxTime, TargetFrameTime * 0.25);
+	} else if (ConveyorLastTime > 0) {
+		if (FrameWorkTime > TargetFrameTime * 1.1) {
+			ConveyorBudget *= 0.5;
+		} else {
+			ConveyorBudget += 0.001;
+		}
+	}
+
+	ConveyorBudget = FMath::Clamp(ConveyorBudget, ConveyorMinTime, ConveyorMaxTime);
+
+	// few per frame ahead of conveyor. material instance is needed by zone apply
+	CreatePendingTransitionMaterials();
+
 	int R = 0;
 	double ConvTime = 0;
-	while (ConvTime < ConveyorMaxTime) {
+	while (ConvTime < ConveyorBudget) {
+		const int TaskClass = Conveyor->front_class();
+		if (TaskClass < 0) {
+			break;
+		}
+
+		// heavy task goes to next frame. at least one task per frame
+		if (R > 0 && ConvTime + Conveyor->estimate_cost(TaskClass) > ConveyorBudget) {
+			break;
+		}
+
 		std::function<void()> Function;
-		if (Conveyor->pop(Function)) {
+		int PopClass;
+		if (Conveyor->pop(Function, PopClass)) {
 			double Start = FPlatformTime::Seconds();
+			ConveyorFrameTime = ConvTime;
 			Function();
 			double End = FPlatformTime::Seconds();
 
@@ -269,6 +332,7 @@ void ASandboxTerrainController::Tick(float DeltaTime) {
 			UE_LOG(LogVt, Warning, TEXT("task = %f ms"), (End - Start) * 1000);
 #endif
 
+			Conveyor->track_cost(PopClass, End - Start);
 			ConvTime += (End - Start);
 			R++;
 		} else {
@@ -276,9 +340,16 @@ void ASandboxTerrainController::Tick(float DeltaTime) {
 		}
 	}
 
+	ConveyorLastTime = ConvTime;
+	ConveyorFrameTime = 0;
+
+	UpdateZoneLods();
+	UpdateZoneBatchSwap();
+	UpdateZoneOcclusion();
+
 #if TRACE_CONVEYOR == 1 
 	if (R > 0) {
-		UE_LOG(LogVt, Warning, TEXT("ConvTime = %f ms"), ConvTime * 1000);
+		UE_LOG(LogVt, Warning, TEXT("ConvTime = %f ms, budget = %f ms"), ConvTime * 1000, ConveyorBudget * 1000);
 		UE_LOG(LogVt, Warning, TEXT("R = %d"), R);
 	}
 #endif
@@ -322,8 +393,32 @@ void ASandboxTerrainController::PerformCheckArea() {
             const FVector PrevLocation = CheckAreaMap->PlayerStreamingPosition.FindOrAdd(PlayerId);
             const float Distance = FVector::Distance(PlayerLocation, PrevLocation);
             const float Threshold = PlayerLocationThreshold;
-            if(Distance > Threshold) {
+
+			FVector2D Lookahead = FVector2D::ZeroVector;
+			FVector2D ViewDirection = FVector2D::ZeroVector;
+			if (bPredictiveStreaming) {
+				// prefetch frontier below keep radius of soft unload
+				const float MaxLookahead = ActiveAreaSize * USBT_ZONE_SIZE * 0.25f;
+				Lookahead = FVector2D(Pawn->GetVelocity()) * StreamingLookaheadTime;
+				if (Lookahead.Size() > MaxLookahead) {
+					Lookahead = Lookahead.GetSafeNormal() * MaxLookahead;
+				}
+
+				if (Lookahead.Size() < USBT_ZONE_SIZE) {
+					Lookahead = FVector2D::ZeroVector;
+				}
+
+				ViewDirection = FVector2D(PlayerController->GetControlRotation().Vector()).GetSafeNormal();
+			}
+
+			// motion direction changed - old prefetch became irrelevant
+			const FVector2D PrevDirection = CheckAreaMap->PlayerStreamingDirection.FindOrAdd(PlayerId);
+			const FVector2D Direction = Lookahead.GetSafeNormal();
+			const bool bDirectionChanged = !Direction.IsZero() && FVector2D::DotProduct(Direction, PrevDirection) < 0.7f && Distance > Threshold * 0.25f;
+
+            if(Distance > Threshold || bDirectionChanged) {
                 CheckAreaMap->PlayerStreamingPosition[PlayerId] = PlayerLocation;
+				CheckAreaMap->PlayerStreamingDirection[PlayerId] = Direction;
                 TVoxelIndex LocationIndex = GetZoneIndex(PlayerLocation);
                 FVector Tmp = GetZonePos(LocationIndex);
                                 
@@ -343,17 +438,38 @@ void ASandboxTerrainController::PerformCheckArea() {
                 }
                 
 				TTerrainAreaLoadParams Params(ActiveAreaSize, ActiveAreaDepth);
+				Params.Lookahead = Lookahead;
+				Params.ViewDirection = ViewDirection;
+				Params.BehindRadiusRatio = Lookahead.IsZero() ? 1.f : StreamingBehindRadiusRatio;
+				Params.bFollowSurface = bSurfaceStreaming;
+				Params.SurfaceMargin = SurfaceStreamingMargin;
                 HandlerPtr->SetParams(TEXT("player_streaming"), this, Params);
                                
+				// moving player goes first. keyed by player: not started load of previous position is replaced
                 AddAsyncTask([=]() {
                     HandlerPtr->LoadArea(PlayerLocation);
-                });
+                }, !Lookahead.IsZero(), ClcAsyncTaskKey(TAsyncTaskType::PlayerStreaming, PlayerId));
 
 				bPerformSoftUnload = true;
             }
         }
     }
 
+	CheckAreaMap->SetFocus(PlayerLocationList);
+
+	UpdateFarTerrain(PlayerLocationList);
+	UpdateZoneBatches();
+	UpdateZoneCollisionLods(PlayerLocationList);
+
+	if (ResidencyBudgetMb > 0 && !bResidencyCheckInProgress && Start - LastResidencyCheck > ResidencyCheckPeriod) {
+		LastResidencyCheck = Start;
+		bResidencyCheckInProgress = true;
+		AddAsyncTask([=, this]() {
+			PerformResidencyCheck(PlayerLocationList);
+			bResidencyCheckInProgress = false;
+		});
+	}
+
 	if (bPerformSoftUnload || bForcePerformHardUnload) {
 		CheckUnreachableZones(PlayerLocationList);		
 	}
@@ -376,50 +492,88 @@ void ASandboxTerrainController::CheckUnreachableZones(const TArray<FVector>& Pla
 	int RestoredCount = 0;
 
 	const float RadiusByPlayerPos = ActiveAreaSize * USBT_ZONE_SIZE;
+	const float RadiusKeepByPlayerPos = RadiusByPlayerPos * 1.5f;
 	const static float RadiusByAnchorObject = USBT_ZONE_SIZE * 1.4142; // sqrt(2)
 
-	TArray<UTerrainZoneComponent*> Components;
-	GetComponents<UTerrainZoneComponent>(Components);
-	for (UTerrainZoneComponent* ZoneComponent : Components) {
-		const FVector ZonePos = ZoneComponent->GetComponentLocation();
-		const TVoxelIndex ZoneIndex = GetZoneIndex(ZonePos);
+	TArray<TVoxelIndex> RestoreZones;
+	TArray<FVector> CellPlayerList;
+	TArray<FVector> CellAnchorList;
 
-		bool bUnload = true;
+	// zone grid cells instead of every zone against every player
+	// XY distance to cell never exceeds 3D distance to zone, so cells far from all players and anchors are unreachable as a whole
+	const float CellSize = TTerrainData::ZoneGridCellSize * USBT_ZONE_SIZE;
+	TerrainData->ForEachZoneGridCell([&](const TVoxelIndex& Cell, const std::unordered_set<TVoxelIndex>& ZoneSet) {
+		const FVector2D CellMin(Cell.X * CellSize, Cell.Y * CellSize);
+		const FBox2D CellBox(CellMin, CellMin + FVector2D(CellSize - USBT_ZONE_SIZE)); // zone centers only
 
+		CellPlayerList.Reset();
 		for (const auto& PlayerLocation : PlayerLocationList) {
-			const float ZoneDistance = FVector::Distance(ZonePos, PlayerLocation);
-
-			if (ZoneDistance < RadiusByPlayerPos * 1.5f) {
-				bUnload = false;
+			if (CellBox.ComputeSquaredDistanceToPoint(FVector2D(PlayerLocation)) < RadiusKeepByPlayerPos * RadiusKeepByPlayerPos) {
+				CellPlayerList.Add(PlayerLocation);
+			}
+		}
 
-				//AsyncTask(ENamedThreads::GameThread, [=, this]() { DrawDebugBox(GetWorld(), ZonePos, FVector(USBT_ZONE_SIZE / 2), FColor(255, 255, 255, 0), false, 5); });
+		CellAnchorList.Reset();
+		for (const auto& Location : AnchorObjectList) {
+			if (CellBox.ComputeSquaredDistanceToPoint(FVector2D(Location)) < RadiusByAnchorObject * RadiusByAnchorObject) {
+				CellAnchorList.Add(Location);
+			}
+		}
 
-				if (ZoneDistance < RadiusByPlayerPos) {
-					// restore soft unload
-					TVoxelDataInfoPtr VoxelDataInfoPtr = GetVoxelDataInfo(ZoneIndex);
-					if (VoxelDataInfoPtr->IsSoftUnload()) {
-						VoxelDataInfoPtr->ResetSoftUnload();
-						OnRestoreZoneSoftUnload(ZoneIndex);
-						RestoredCount++;
-					}
-				}
+		if (CellPlayerList.Num() == 0 && CellAnchorList.Num() == 0) {
+			for (const TVoxelIndex& ZoneIndex : ZoneSet) {
+				UnreachableZones.Add(ZoneIndex);
 			}
+			return;
 		}
 
-		if (bUnload) {
-			for (const auto& Location : AnchorObjectList) {
+		for (const TVoxelIndex& ZoneIndex : ZoneSet) {
+			const FVector ZonePos = GetZonePos(ZoneIndex);
 
-				//AsyncTask(ENamedThreads::GameThread, [&]() { DrawDebugBox(GetWorld(), Location, FVector(500), FColor(0, 0, 255, 0), true); });
+			bool bUnload = true;
+			bool bRestore = false;
 
-				if (FVector::Distance(ZonePos, Location) < RadiusByAnchorObject) {
+			for (const auto& PlayerLocation : CellPlayerList) {
+				const float ZoneDistance = FVector::Distance(ZonePos, PlayerLocation);
+
+				if (ZoneDistance < RadiusKeepByPlayerPos) {
 					bUnload = false;
-					//AsyncTask(ENamedThreads::GameThread, [=, this]() { DrawDebugBox(GetWorld(), ZonePos, FVector(USBT_ZONE_SIZE / 2), FColor(255, 255, 255, 0), true); });
+
+					//AsyncTask(ENamedThreads::GameThread, [=, this]() { DrawDebugBox(GetWorld(), ZonePos, FVector(USBT_ZONE_SIZE / 2), FColor(255, 255, 255, 0), false, 5); });
+
+					if (ZoneDistance < RadiusByPlayerPos) {
+						bRestore = true;
+						break;
+					}
+				}
+			}
+
+			if (bUnload) {
+				for (const auto& Location : CellAnchorList) {
+					if (FVector::Distance(ZonePos, Location) < RadiusByAnchorObject) {
+						bUnload = false;
+						break;
+					}
 				}
 			}
+
+			if (bRestore) {
+				RestoreZones.Add(ZoneIndex);
+			}
+
+			if (bUnload) {
+				UnreachableZones.Add(ZoneIndex);
+			}
 		}
+	});
 
-		if (bUnload) {
-			UnreachableZones.Add(ZoneIndex);
+	// restore soft unload outside of zone grid lock
+	for (const TVoxelIndex& ZoneIndex : RestoreZones) {
+		TVoxelDataInfoPtr VoxelDataInfoPtr = GetVoxelDataInfo(ZoneIndex);
+		if (VoxelDataInfoPtr->IsSoftUnload()) {
+			VoxelDataInfoPtr->ResetSoftUnload();
+			OnRestoreZoneSoftUnload(ZoneIndex);
+			RestoredCount++;
 		}
 	}
 	
@@ -427,6 +581,8 @@ void ASandboxTerrainController::CheckUnreachableZones(const TArray<FVector>& Pla
 		UE_LOG(LogVt, Log, TEXT("Soft unloaded zones restored: %d"), RestoredCount);
 	}
 
+	CancelUnreachableZoneApply(PlayerLocationList, AnchorObjectList);
+
 	UE_LOG(LogVt, Log, TEXT("Found unreachable zones: %d"), UnreachableZones.Num());
 
 	UnloadUnreachableZones(UnreachableZones);
@@ -456,6 +612,7 @@ void ASandboxTerrainController::UnloadUnreachableZones(const TArray<TVoxelIndex>
 
 	int HardCount = 0;
 	int SoftCount = 0;
+	int DestroyedCount = 0;
 
 	for (const auto& ZoneIndex : UnreachableZones) {
 		UTerrainZoneComponent* ZoneComponent = GetZoneByVectorIndex(ZoneIndex);
@@ -464,12 +621,15 @@ void ASandboxTerrainController::UnloadUnreachableZones(const TArray<TVoxelIndex>
 		SoftCount++;
 
 		if (bForcePerformHardUnload) {
-			ZoneHardUnload(ZoneComponent, ZoneIndex);
+			if (ZoneHardUnload(ZoneComponent, ZoneIndex)) {
+				DestroyedCount++;
+			}
 			HardCount++;
 		}
 	}
 
-	if (HardCount > 0) {
+	// pooled components are not garbage
+	if (DestroyedCount > 0) {
 		GEngine->ForceGarbageCollection();
 	}
 
@@ -482,22 +642,41 @@ void ASandboxTerrainController::UnloadUnreachableZones(const TArray<TVoxelIndex>
 	UE_LOG(LogVt, Log, TEXT("Unload unreachable zones: hard = %d, soft = %d --> %f ms"), HardCount, SoftCount, Time);
 }
 
-void ASandboxTerrainController::ZoneHardUnload(UTerrainZoneComponent* ZoneComponent, const TVoxelIndex& ZoneIndex) {
+// return true if component destroyed
+bool ASandboxTerrainController::ReleaseZoneComponent(UTerrainZoneComponent* ZoneComponent) {
+	if (ZonePool.Num() < ZonePoolSize && ZoneComponent->MainTerrainMesh) {
+		ZoneComponent->ResetForPool();
+		ZoneComponent->Rename(nullptr, nullptr, REN_DontCreateRedirectors | REN_NonTransactional | REN_ForceNoResetLoaders);
+		ZoneComponent->MainTerrainMesh->Rename(nullptr, nullptr, REN_DontCreateRedirectors | REN_NonTransactional | REN_ForceNoResetLoaders);
+		ZonePool.Add(ZoneComponent);
+		zone_counter--;
+		return false;
+	}
+
+	RemoveAllChilds(ZoneComponent);
+	ZoneComponent->DestroyComponent(true);
+	return true;
+}
+
+// return true if component destroyed
+bool ASandboxTerrainController::ZoneHardUnload(UTerrainZoneComponent* ZoneComponent, const TVoxelIndex& ZoneIndex) {
 	TVoxelDataInfoPtr VdInfoPtr = TerrainData->GetVoxelDataInfo(ZoneIndex);
 	TVdInfoLockGuard Lock(VdInfoPtr);
 
 	FVector ZonePos = ZoneComponent->GetComponentLocation();
 	if (VdInfoPtr->IsSoftUnload() && !VdInfoPtr->IsNeedObjectsSave()) {
 		if (VdInfoPtr->IsSpawnFinished()) {
-			RemoveAllChilds(ZoneComponent);
+			MarkZoneBatchDirty(ZoneIndex);
 			TerrainData->RemoveZone(ZoneIndex);
-			ZoneComponent->DestroyComponent(true);
+			return ReleaseZoneComponent(ZoneComponent);
 		} else {
 			//AsyncTask(ENamedThreads::GameThread, [&, this]() { DrawDebugBox(GetWorld(), ZonePos, FVector(USBT_ZONE_SIZE / 2), FColor(255, 0, 0, 0), false, 5); });
 		}
 	} else {
 		//AsyncTask(ENamedThreads::GameThread, [&, this]() { DrawDebugBox(GetWorld(), ZonePos, FVector(USBT_ZONE_SIZE / 2), FColor(255, 0, 0, 0), false, 5); });
 	}
+
+	return false;
 }
 
 void ASandboxTerrainController::ZoneSoftUnload(UTerrainZoneComponent* ZoneComponent, const TVoxelIndex& ZoneIndex) {
@@ -512,6 +691,125 @@ void ASandboxTerrainController::ZoneSoftUnload(UTerrainZoneComponent* ZoneCompon
 	} 
 }
 
+//======================================================================================================================================================================
+// memory residency
+//======================================================================================================================================================================
+
+struct TResidencyItem {
+	TVoxelIndex Index;
+	TVoxelDataInfoPtr VdInfoPtr;
+	size_t Size = 0;
+	double Score = 0;
+};
+
+// worker thread. evict voxel data, mesh cache and instance objects of least valuable zones until total size fits the budget
+void ASandboxTerrainController::PerformResidencyCheck(const TArray<FVector>& PlayerLocationList) {
+	double Start = FPlatformTime::Seconds();
+
+	const size_t Budget = (size_t)ResidencyBudgetMb * 1024 * 1024;
+
+	std::vector<TResidencyItem> ItemList;
+	TerrainData->ForEachVoxelDataInfo([&](const TVoxelIndex& Index, const TVoxelDataInfoPtr& VdInfoPtr) {
+		ItemList.push_back({ Index, VdInfoPtr });
+	});
+
+	size_t Total = 0;
+	for (auto& Itm : ItemList) {
+		// busy zone is in use. count last known size, but not evict
+		if (!Itm.VdInfoPtr->TryLock()) {
+			Total += Itm.VdInfoPtr->GetLastMemorySize();
+			continue;
+		}
+
+		Itm.Size = Itm.VdInfoPtr->ClcMemorySize();
+		const bool bDirty = Itm.VdInfoPtr->IsNeedTerrainSave() || Itm.VdInfoPtr->IsNeedObjectsSave();
+		Itm.VdInfoPtr->Unlock();
+
+		Total += Itm.Size;
+
+		float MinDist = (PlayerLocationList.Num() > 0) ? FLT_MAX : 0;
+		const FVector ZonePos = GetZonePos(Itm.Index);
+		for (const auto& Location : PlayerLocationList) {
+			MinDist = FMath::Min(MinDist, (float)FVector::Distance(ZonePos, Location));
+		}
+
+		// higher evicts first: seconds since last access, distance in zones, dirty zone costs write back
+		const float DistZones = MinDist / USBT_ZONE_SIZE;
+		Itm.Score = (Start - Itm.VdInfoPtr->GetLastAccess()) + DistZones * 10 - (bDirty ? 30 : 0);
+		if (DistZones < 2) {
+			Itm.Size = 0; // keep zones around player
+		}
+	}
+
+	if (Total <= Budget) {
+		return;
+	}
+
+	std::sort(ItemList.begin(), ItemList.end(), [](const TResidencyItem& A, const TResidencyItem& B) { return A.Score > B.Score; });
+
+	// lock order as in Save: save mutex, then zone
+	const std::lock_guard<std::mutex> SaveLock(SaveMutex);
+
+	const size_t Target = Budget / 10 * 9;
+	int WriteBackCount = 0;
+	int EvictedCount = 0;
+	int DeferredCount = 0;
+	const size_t TotalBefore = Total;
+
+	for (auto& Itm : ItemList) {
+		if (Total <= Target || bIsWorkFinished) {
+			break;
+		}
+
+		if (Itm.Size == 0) {
+			continue;
+		}
+
+		TVoxelDataInfoPtr VdInfoPtr = Itm.VdInfoPtr;
+		TVdInfoLockGuard Lock(VdInfoPtr);
+
+		// edit is not yet remeshed or applied, so save flag is not set. apply sets flag and save index, evict on next check
+		if (VdInfoPtr->IsNeedToRegenerateMesh() || IsZoneApplyQueued(Itm.Index)) {
+			DeferredCount++;
+			continue;
+		}
+
+		// write back applied edit before eviction
+		if (DataFileId > 0 && (VdInfoPtr->IsNeedTerrainSave() || VdInfoPtr->IsNeedObjectsSave())) {
+			SaveZoneData(Itm.Index, VdInfoPtr);
+			VdInfoPtr->ResetLastSave();
+			WriteBackCount++;
+		}
+
+		// no terrain file. keep zone until save
+		if (VdInfoPtr->IsNeedTerrainSave() || VdInfoPtr->IsChanged()) {
+			TerrainData->AddSaveIndex(Itm.Index);
+			DeferredCount++;
+			continue;
+		}
+
+		// generated voxel data can be reloaded only after save
+		if (VdInfoPtr->Vd && (VdInfoPtr->IsNewLoaded() || (VdInfoPtr->IsNewGenerated() && VdInfoPtr->IsSaved()))) {
+			VdInfoPtr->Unload();
+		}
+
+		VdInfoPtr->PopMeshDataCache();
+
+		// instance objects of pending spawn are not yet applied to zone
+		if (VdInfoPtr->IsSoftUnload() && !VdInfoPtr->IsNeedObjectsSave()) {
+			VdInfoPtr->ClearInstanceObjectMap();
+		}
+
+		const size_t NewSize = VdInfoPtr->ClcMemorySize();
+		Total -= (Itm.Size > NewSize) ? Itm.Size - NewSize : 0;
+		EvictedCount++;
+	}
+
+	double End = FPlatformTime::Seconds();
+	double Time = (End - Start) * 1000;
+	UE_LOG(LogVt, Log, TEXT("Residency: %d MB -> %d MB, budget %d MB, evicted = %d, write back = %d, deferred = %d --> %f ms"), (int)(TotalBefore >> 20), (int)(Total >> 20), ResidencyBudgetMb, EvictedCount, WriteBackCount, DeferredCount, Time);
+}
+
 //======================================================================================================================================================================
 // begin play
 //======================================================================================================================================================================
@@ -563,6 +861,8 @@ void ASandboxTerrainController::BeginServerTerrainLoad() {
 
         // async loading other zones
 		TTerrainAreaLoadParams Params(ActiveAreaSize, ActiveAreaDepth);
+		Params.bFollowSurface = bSurfaceStreaming;
+		Params.SurfaceMargin = SurfaceStreamingMargin;
         AddAsyncTask([=, this]() {            
 			UE_LOG(LogVt, Warning, TEXT("Server: Begin terrain load at location: %f %f %f"), BeginServerTerrainLoadLocation.X, BeginServerTerrainLoadLocation.Y, BeginServerTerrainLoadLocation.Z);
 
@@ -575,7 +875,9 @@ void ASandboxTerrainController::BeginServerTerrainLoad() {
 				AsyncTask(ENamedThreads::GameThread, [&] {
 
 #if ENGINE_MAJOR_VERSION == 5 && (ENGINE_MINOR_VERSION == 1 || ENGINE_MINOR_VERSION == 2)
-					UE51MaterialIssueWorkaround();
+					if (bMaterialCreatedOnLoad) {
+						UE51MaterialIssueWorkaround();
+					}
 #endif
 					AddTaskToConveyor([=, this] {
 						OnFinishInitialLoad(); 
@@ -631,7 +933,9 @@ void ASandboxTerrainController::BeginClientTerrainLoad(const TVoxelIndex& ZoneIn
 			AsyncTask(ENamedThreads::GameThread, [&] {
 
 #if ENGINE_MAJOR_VERSION == 5 && (ENGINE_MINOR_VERSION == 1 || ENGINE_MINOR_VERSION == 2)
-				UE51MaterialIssueWorkaround();
+				if (bMaterialCreatedOnLoad) {
+					UE51MaterialIssueWorkaround();
+				}
 #endif
 				AddTaskToConveyor([=, this] {
 					OnFinishInitialLoad();
@@ -746,6 +1050,7 @@ void ASandboxTerrainController::BatchGenerateZone(const TArray<TSpawnZoneParam>&
 		const auto& GenResult = GenResultArray[Idx];
 
 		VdInfoPtr->Vd = GenResult.Vd;
+		VdInfoPtr->Touch();
 		FVector v = VdInfoPtr->Vd->getOrigin();
 
 		if (GenResult.Method == TGenerationMethod::FastSimple || GenResult.Method == Skip) {
@@ -762,6 +1067,31 @@ void ASandboxTerrainController::BatchGenerateZone(const TArray<TSpawnZoneParam>&
 	}
 }
 
+// false if zone is known as empty or solid: by voxel data in memory, saved flags or generator prediction
+bool ASandboxTerrainController::CheckZoneCanHaveGeometry(const TVoxelIndex& Index) {
+	TVoxelDataInfoPtr VdInfoPtr = TerrainData->FindVoxelDataInfo(Index);
+	if (VdInfoPtr) {
+		TVdInfoLockGuard Lock(VdInfoPtr);
+		if (VdInfoPtr->Vd) {
+			return VdInfoPtr->Vd->getDensityFillState() == TVoxelDataFillState::MIXED;
+		}
+	}
+
+	TFileItmKey Key{ Index, TFileItmType::MESH_DATA };
+	if (FKvdb::HasKey(DataFileId, Key)) {
+		std::bitset<sizeof(uint64)> ZoneFlags(FKvdb::GetKeyFlags(DataFileId, Key));
+		return !ZoneFlags.test((size_t)TZoneFlag::NoMesh);
+	}
+
+	UTerrainGeneratorComponent* Generator = GetTerrainGenerator();
+	if (!Generator) {
+		return true;
+	}
+
+	const TZoneGenerationType Type = Generator->PredictZoneGenType(Index);
+	return Type == TZoneGenerationType::Landscape || Type == TZoneGenerationType::Other;
+}
+
 void ASandboxTerrainController::BatchSpawnZone(const TArray<TSpawnZoneParam>& SpawnZoneParamArray) {
 	TArray<TSpawnZoneParam> GenerationList;
 	TArray<TSpawnZoneParam> LoadList;
@@ -835,6 +1165,7 @@ void ASandboxTerrainController::ExecGameThreadMoMeshZoneSpawn(const TArray<TVoxe
 
 		std::function<void()> Function = [=, this]() {
 			OnFinishLoadZone(Index);
+			bZoneOcclusionDirty = true;
 		};
 
 		AddTaskToConveyor(Function);
@@ -926,28 +1257,42 @@ UTerrainZoneComponent* ASandboxTerrainController::AddTerrainZone(FVector Pos) {
 
     FVector IndexTmp(Index.X, Index.Y,Index.Z);
     FString ZoneName = FString::Printf(TEXT("Zone [%.0f, %.0f, %.0f]"), IndexTmp.X, IndexTmp.Y, IndexTmp.Z);
-    UTerrainZoneComponent* ZoneComponent = NewObject<UTerrainZoneComponent>(this, FName(*ZoneName));
-    if (ZoneComponent) {
-		ZoneComponent->SetIsReplicated(true);
-        ZoneComponent->RegisterComponent();
-        //ZoneComponent->SetRelativeLocation(pos);
-        ZoneComponent->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepRelativeTransform, NAME_None);
-        ZoneComponent->SetWorldLocation(Pos);
-		ZoneComponent->SetMobility(EComponentMobility::Movable);
-		zone_counter++;
 
-        FString TerrainMeshCompName = FString::Printf(TEXT("TerrainMesh [%.0f, %.0f, %.0f]"), IndexTmp.X, IndexTmp.Y, IndexTmp.Z);
-        UVoxelMeshComponent* TerrainMeshComp = NewObject<UVoxelMeshComponent>(this, FName(*TerrainMeshCompName));
-		TerrainMeshComp->SetIsReplicated(true);
-        TerrainMeshComp->RegisterComponent();
-        TerrainMeshComp->SetMobility(EComponentMobility::Movable);
-        TerrainMeshComp->SetCanEverAffectNavigation(true);
-        TerrainMeshComp->SetCollisionProfileName(TEXT("InvisibleWall"));
-        TerrainMeshComp->AttachToComponent(ZoneComponent, FAttachmentTransformRules::KeepRelativeTransform, NAME_None);
-        TerrainMeshComp->ZoneIndex = Index;
-
-        ZoneComponent->MainTerrainMesh = TerrainMeshComp;
-    }
+    FString TerrainMeshCompName = FString::Printf(TEXT("TerrainMesh [%.0f, %.0f, %.0f]"), IndexTmp.X, IndexTmp.Y, IndexTmp.Z);
+
+	// reuse unloaded zone component
+	UTerrainZoneComponent* ZoneComponent = nullptr;
+	if (ZonePool.Num() > 0) {
+		ZoneComponent = ZonePool.Pop(false);
+		ZoneComponent->Rename(*ZoneName, nullptr, REN_DontCreateRedirectors | REN_NonTransactional | REN_ForceNoResetLoaders);
+		ZoneComponent->MainTerrainMesh->Rename(*TerrainMeshCompName, nullptr, REN_DontCreateRedirectors | REN_NonTransactional | REN_ForceNoResetLoaders);
+		ZoneComponent->SetWorldLocation(Pos);
+		ZoneComponent->RestoreFromPool();
+		ZoneComponent->MainTerrainMesh->ZoneIndex = Index;
+		zone_counter++;
+	} else {
+		ZoneComponent = NewObject<UTerrainZoneComponent>(this, FName(*ZoneName));
+		if (ZoneComponent) {
+			ZoneComponent->SetIsReplicated(true);
+			ZoneComponent->RegisterComponent();
+			//ZoneComponent->SetRelativeLocation(pos);
+			ZoneComponent->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepRelativeTransform, NAME_None);
+			ZoneComponent->SetWorldLocation(Pos);
+			ZoneComponent->SetMobility(EComponentMobility::Movable);
+			zone_counter++;
+
+			UVoxelMeshComponent* TerrainMeshComp = NewObject<UVoxelMeshComponent>(this, FName(*TerrainMeshCompName));
+			TerrainMeshComp->SetIsReplicated(true);
+			TerrainMeshComp->RegisterComponent();
+			TerrainMeshComp->SetMobility(EComponentMobility::Movable);
+			TerrainMeshComp->SetCanEverAffectNavigation(true);
+			TerrainMeshComp->SetCollisionProfileName(TEXT("InvisibleWall"));
+			TerrainMeshComp->AttachToComponent(ZoneComponent, FAttachmentTransformRules::KeepRelativeTransform, NAME_None);
+			TerrainMeshComp->ZoneIndex = Index;
+
+			ZoneComponent->MainTerrainMesh = TerrainMeshComp;
+		}
+	}
 
     TerrainData->AddZone(Index, ZoneComponent);
 
@@ -1018,154 +1363,1285 @@ TVoxelIndex ASandboxTerrainController::ClcRegionOrigin(const TVoxelIndex& Region
 }
 
 //======================================================================================================================================================================
-// invoke async
+// far terrain
 //======================================================================================================================================================================
 
+// far terrain cell side in quads. one quad: cell covers whole zones and is culled by loaded zones under it
+#define USBT_FAR_TERRAIN_CELL_SIZE 1
 
-void ASandboxTerrainController::InvokeSafe(std::function<void()> Function) {
-    if (IsInGameThread()) {
-        Function();
-    } else {
-        AsyncTask(ENamedThreads::GameThread, [=]() { Function(); });
-    }
-}
+// far terrain is placed a bit lower than real zones to avoid z-fighting at active area edge
+#define USBT_FAR_TERRAIN_DEPTH_BIAS 100.f
 
-void ASandboxTerrainController::AddTaskToConveyor(std::function<void()> Function) {
-	if (bEnableConveyor) {
-		Conveyor->push(Function);
-	} else {
-		if (IsInGameThread()) {
-			Function();
-		} else {
-			UE_LOG(LogVt, Error, TEXT("Conveyor is disabled. Attempt to run conveyor task in non game thread"));
+// region height field by generator ground level. each cell has own continuous index range
+std::shared_ptr<TFarTerrainMeshData> ASandboxTerrainController::GenerateFarTerrainMesh(const TVoxelIndex& RegionIndex) {
+	const UTerrainGeneratorComponent* Generator = GetTerrainGenerator();
+	const int Step = FMath::Max(1, (int)FarTerrainStep);
+	const int RegionZones = GetRegionSize() * 2 + 1;
+	const int Q = (RegionZones + Step - 1) / Step; // quads per side
+	const int V = Q + 1; // vertices per side
+	const float Extend = RegionZones * USBT_ZONE_SIZE * 0.5f;
+	const FVector Origin = GetZonePos(ClcRegionOrigin(RegionIndex));
+
+	// last quad can be shorter. region edges are shared with neighbor regions
+	auto SamplePos = [=](const int I) {
+		return FMath::Min(-Extend + (float)(I * Step) * USBT_ZONE_SIZE, Extend);
+	};
+
+	TArray<float> HeightArray;
+	HeightArray.SetNumUninitialized(V * V);
+	for (int Y = 0; Y < V; Y++) {
+		for (int X = 0; X < V; X++) {
+			const FVector WorldPos(Origin.X + SamplePos(X), Origin.Y + SamplePos(Y), 0);
+			HeightArray[Y * V + X] = Generator->GroundLevelFunction(GetZoneIndex(WorldPos), WorldPos) - USBT_FAR_TERRAIN_DEPTH_BIAS;
 		}
 	}
-}
 
-void ASandboxTerrainController::ExecGameThreadZoneApplyMesh(const TVoxelIndex& Index, UTerrainZoneComponent* Zone, TMeshDataPtr MeshDataPtr) {
-	ASandboxTerrainController* Controller = this;
-
-	std::function<void()> Function = [=, this]() {
-		if (!bIsGameShutdown) {
-			if (MeshDataPtr) {		
-				TVoxelDataInfoPtr VdInfoPtr = TerrainData->GetVoxelDataInfo(Index);
-				TVdInfoLockGuard Lock(VdInfoPtr);
-
-				TerrainData->PutMeshDataToCache(Index, MeshDataPtr);
+	std::shared_ptr<TFarTerrainMeshData> MeshDataPtr = std::make_shared<TFarTerrainMeshData>();
+	MeshDataPtr->MaterialId = Generator->DfaultGrassMaterialId;
+	FProcMeshSection& Mesh = MeshDataPtr->Mesh;
+
+	Mesh.ProcVertexBuffer.Reserve(V * V);
+	for (int Y = 0; Y < V; Y++) {
+		for (int X = 0; X < V; X++) {
+			const int X0 = FMath::Max(X - 1, 0);
+			const int X1 = FMath::Min(X + 1, Q);
+			const int Y0 = FMath::Max(Y - 1, 0);
+			const int Y1 = FMath::Min(Y + 1, Q);
+
+			const float DHX = (HeightArray[Y * V + X1] - HeightArray[Y * V + X0]) / (SamplePos(X1) - SamplePos(X0));
+			const float DHY = (HeightArray[Y1 * V + X] - HeightArray[Y0 * V + X]) / (SamplePos(Y1) - SamplePos(Y0));
+
+			TMeshVertex Vertex;
+			Vertex.Pos = FVector(SamplePos(X), SamplePos(Y), HeightArray[Y * V + X]);
+			Vertex.Normal = FVector(-DHX, -DHY, 1.f).GetSafeNormal();
+			Mesh.AddVertex(Vertex);
+		}
+	}
 
-				ApplyTerrainMesh(Zone, MeshDataPtr);
-				VdInfoPtr->SetNeedTerrainSave();
-				TerrainData->AddSaveIndex(Index);
+	const int CellNum = (Q + USBT_FAR_TERRAIN_CELL_SIZE - 1) / USBT_FAR_TERRAIN_CELL_SIZE;
+	Mesh.ProcIndexBuffer.Reserve(Q * Q * 6);
+	MeshDataPtr->CellNum = CellNum;
+	MeshDataPtr->CellFirstIndex.Reserve(CellNum * CellNum + 1);
+	MeshDataPtr->CellBox.Reserve(CellNum * CellNum);
+
+	for (int CY = 0; CY < CellNum; CY++) {
+		for (int CX = 0; CX < CellNum; CX++) {
+			MeshDataPtr->CellFirstIndex.Add(Mesh.ProcIndexBuffer.Num());
+			FBox CellBox(ForceInit);
+
+			const int MaxY = FMath::Min((CY + 1) * USBT_FAR_TERRAIN_CELL_SIZE, Q);
+			const int MaxX = FMath::Min((CX + 1) * USBT_FAR_TERRAIN_CELL_SIZE, Q);
+			for (int Y = CY * USBT_FAR_TERRAIN_CELL_SIZE; Y < MaxY; Y++) {
+				for (int X = CX * USBT_FAR_TERRAIN_CELL_SIZE; X < MaxX; X++) {
+					const uint32 I00 = Y * V + X;
+					const uint32 I10 = I00 + 1;
+					const uint32 I01 = I00 + V;
+					const uint32 I11 = I01 + 1;
+
+					// same winding as voxel mesh
+					Mesh.ProcIndexBuffer.Add(I00);
+					Mesh.ProcIndexBuffer.Add(I11);
+					Mesh.ProcIndexBuffer.Add(I10);
+
+					Mesh.ProcIndexBuffer.Add(I00);
+					Mesh.ProcIndexBuffer.Add(I01);
+					Mesh.ProcIndexBuffer.Add(I11);
+
+					CellBox += Mesh.ProcVertexBuffer[I00].Pos;
+					CellBox += Mesh.ProcVertexBuffer[I10].Pos;
+					CellBox += Mesh.ProcVertexBuffer[I01].Pos;
+					CellBox += Mesh.ProcVertexBuffer[I11].Pos;
+				}
 			}
+
+			MeshDataPtr->CellBox.Add(CellBox);
 		}
-	};
+	}
 
-	AddTaskToConveyor(Function);
+	MeshDataPtr->CellFirstIndex.Add(Mesh.ProcIndexBuffer.Num());
+	MeshDataPtr->RenderSection = BuildMeshRenderSection(Mesh);
+	return MeshDataPtr;
 }
 
-void ASandboxTerrainController::ExecGameThreadAddZoneAndApplyMesh(const TVoxelIndex& Index, TMeshDataPtr MeshDataPtr, const bool bIsNewGenerated, const bool bIsChanged) {
-	FVector ZonePos = GetZonePos(Index);
-	ASandboxTerrainController* Controller = this;
+// always in game thread
+void ASandboxTerrainController::SpawnFarTerrain(const TVoxelIndex& RegionIndex, std::shared_ptr<TFarTerrainMeshData> MeshDataPtr) {
+	const FString Name = FString::Printf(TEXT("FarTerrain [%d, %d]"), RegionIndex.X, RegionIndex.Y);
+	UFarTerrainComponent* FarTerrain = NewObject<UFarTerrainComponent>(this, MakeUniqueObjectName(this, UFarTerrainComponent::StaticClass(), FName(*Name)));
+	if (!FarTerrain) {
+		return;
+	}
 
-	std::function<void()> Function = [=, this]() {
-		if (!bIsGameShutdown) {
-			if (MeshDataPtr) {
-				TVoxelDataInfoPtr VdInfoPtr = TerrainData->GetVoxelDataInfo(Index);
-				TVdInfoLockGuard Lock(VdInfoPtr);
-				//TerrainData->PutMeshDataToCache(Index, MeshDataPtr);
-
-				UTerrainZoneComponent* Zone = AddTerrainZone(ZonePos);
-				if (Zone) {
-					ApplyTerrainMesh(Zone, MeshDataPtr);
-
-					if (bIsChanged) {
-						TerrainData->PutMeshDataToCache(Index, MeshDataPtr);
-						VdInfoPtr->SetNeedTerrainSave();
-						TerrainData->AddSaveIndex(Index);
-					}
+	FarTerrain->RegionIndex = RegionIndex;
 
-					if (bIsNewGenerated) {
-						OnGenerateNewZone(Index, Zone);
-					} else {
-						OnLoadZone(Index, Zone);
-					}
-				}
-			}
-		} 
-	};
+	FarTerrain->RegisterComponent();
+	FarTerrain->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepRelativeTransform, NAME_None);
+	FarTerrain->SetWorldLocation(GetZonePos(ClcRegionOrigin(RegionIndex)));
+	FarTerrain->SetFarTerrainMeshData(MeshDataPtr, GetRegularTerrainMaterial(MeshDataPtr->MaterialId));
 
-	AddTaskToConveyor(Function);
-}
+	TBitArray<> CoveredCellMask;
+	ClcFarTerrainCoverage(RegionIndex, *MeshDataPtr, CoveredCellMask);
+	FarTerrain->SetCoveredCells(CoveredCellMask);
 
-void ASandboxTerrainController::AddAsyncTask(std::function<void()> Function) {
-	ThreadPool->addTask(Function);
+	FarTerrainMap.Add(RegionIndex, FarTerrain);
 }
 
-//======================================================================================================================================================================
-// events
-//======================================================================================================================================================================
+// game thread. cell is covered when all zones in its column and height range are spawned and applied.
+// zones are loaded only in active area, so only cells near players are checked
+void ASandboxTerrainController::ClcFarTerrainCoverage(const TVoxelIndex& RegionIndex, const TFarTerrainMeshData& MeshData, TBitArray<>& CoveredCellMask) {
+	CoveredCellMask.Init(false, MeshData.CellBox.Num());
+	if (MeshData.CellNum == 0) {
+		return;
+	}
 
-void ASandboxTerrainController::OnGenerateNewZone(const TVoxelIndex& Index, UTerrainZoneComponent* Zone) {
-	TVoxelDataInfoPtr VdInfoPtr = TerrainData->GetVoxelDataInfo(Index);
+	const int Step = FMath::Max(1, (int)FarTerrainStep) * USBT_FAR_TERRAIN_CELL_SIZE;
+	const int RegionSize = GetRegionSize();
+	const TVoxelIndex RegionOrigin = ClcRegionOrigin(RegionIndex);
+	const FVector Origin = GetZonePos(RegionOrigin);
+	const TVoxelIndex MinZone(RegionOrigin.X - RegionSize, RegionOrigin.Y - RegionSize, 0);
+	const TVoxelIndex MaxZone(RegionOrigin.X + RegionSize, RegionOrigin.Y + RegionSize, 0);
+	const int AreaRadius = ActiveAreaSize + 1;
+
+	for (const FVector& Location : FarTerrainFocusList) {
+		const TVoxelIndex Center = GetZoneIndex(Location);
+		const int CX0 = FMath::Max(0, FMath::FloorToInt((float)(Center.X - AreaRadius - MinZone.X) / Step));
+		const int CX1 = FMath::Min(MeshData.CellNum - 1, FMath::FloorToInt((float)(Center.X + AreaRadius - MinZone.X) / Step));
+		const int CY0 = FMath::Max(0, FMath::FloorToInt((float)(Center.Y - AreaRadius - MinZone.Y) / Step));
+		const int CY1 = FMath::Min(MeshData.CellNum - 1, FMath::FloorToInt((float)(Center.Y + AreaRadius - MinZone.Y) / Step));
+
+		for (int CY = CY0; CY <= CY1; CY++) {
+			for (int CX = CX0; CX <= CX1; CX++) {
+				const int32 CellIdx = CY * MeshData.CellNum + CX;
+				const FBox& Box = MeshData.CellBox[CellIdx];
+				if (CoveredCellMask[CellIdx] || !Box.IsValid) {
+					continue;
+				}
 
-    if (FoliageDataAsset) {
-		TInstanceMeshTypeMap& ZoneInstanceObjectMap = *TerrainData->GetOrCreateInstanceObjectMap(Index);
-		Zone->SpawnAll(ZoneInstanceObjectMap);
-		VdInfoPtr->SetNeedObjectsSave();
-    }
+				const int Z0 = GetZoneIndex(FVector(Origin.X, Origin.Y, Origin.Z + Box.Min.Z)).Z;
+				const int Z1 = GetZoneIndex(FVector(Origin.X, Origin.Y, Origin.Z + Box.Max.Z)).Z;
+				const int X1 = FMath::Min(MinZone.X + (CX + 1) * Step - 1, MaxZone.X);
+				const int Y1 = FMath::Min(MinZone.Y + (CY + 1) * Step - 1, MaxZone.Y);
+
+				bool bCovered = true;
+				for (int X = MinZone.X + CX * Step; X <= X1 && bCovered; X++) {
+					for (int Y = MinZone.Y + CY * Step; Y <= Y1 && bCovered; Y++) {
+						for (int Z = Z0; Z <= Z1 && bCovered; Z++) {
+							const TVoxelIndex ZoneIndex(X, Y, Z);
+							TVoxelDataInfoPtr VdInfoPtr = TerrainData->FindVoxelDataInfo(ZoneIndex);
+							bCovered = VdInfoPtr && VdInfoPtr->IsSpawnFinished() && !IsZoneApplyQueued(ZoneIndex);
+						}
+					}
+				}
 
-	OnFinishGenerateNewZone(Index);
-	VdInfoPtr->ClearInstanceObjectMap();
-	VdInfoPtr->SetNeedTerrainSave();
-	TerrainData->AddSaveIndex(Index);
+				CoveredCellMask[CellIdx] = bCovered;
+			}
+		}
+	}
 }
 
-void ASandboxTerrainController::OnLoadZone(const TVoxelIndex& Index, UTerrainZoneComponent* Zone) {
-	TVoxelDataInfoPtr VdInfoPtr = TerrainData->GetVoxelDataInfo(Index);
+// always in game thread
+void ASandboxTerrainController::UpdateFarTerrain(const TArray<FVector>& PlayerLocationList) {
+	if (!bEnableFarTerrain || GetNetMode() == NM_DedicatedServer || !GetTerrainGenerator()) {
+		return;
+	}
 
-	if (FoliageDataAsset) {
-		TInstanceMeshTypeMap& ZoneInstanceObjectMap = *TerrainData->GetOrCreateInstanceObjectMap(Index);
-		Zone->SpawnAll(ZoneInstanceObjectMap);
+	const int RegionZones = GetRegionSize() * 2 + 1;
+	const float RegionExtend = RegionZones * USBT_ZONE_SIZE * 0.5f;
+	const float Radius = FarTerrainRadius * USBT_ZONE_SIZE;
+	const int R = FMath::CeilToInt(Radius * 2.f / (RegionZones * USBT_ZONE_SIZE)) + 1;
+
+	FarTerrainFocusList = PlayerLocationList;
+
+	// regions in radius are visible. regions in double radius are kept in cache
+	TSet<TVoxelIndex> CacheSet;
+	FarTerrainRequired.Empty();
+	for (const FVector& Location : PlayerLocationList) {
+		const FVector2D Location2D(Location.X, Location.Y);
+		const TVoxelIndex Center = ClcRegionByZoneIndex(GetZoneIndex(Location));
+		for (int X = -R; X <= R; X++) {
+			for (int Y = -R; Y <= R; Y++) {
+				const TVoxelIndex RegionIndex(Center.X + X, Center.Y + Y, 0);
+				const FVector Origin = GetZonePos(ClcRegionOrigin(RegionIndex));
+				const FBox2D RegionBox(FVector2D(Origin.X - RegionExtend, Origin.Y - RegionExtend), FVector2D(Origin.X + RegionExtend, Origin.Y + RegionExtend));
+				const float DistSquared = RegionBox.ComputeSquaredDistanceToPoint(Location2D);
+
+				if (DistSquared <= Radius * Radius) {
+					FarTerrainRequired.Add(RegionIndex);
+				}
+
+				if (DistSquared <= Radius * Radius * 4.f) {
+					CacheSet.Add(RegionIndex);
+				}
+			}
+		}
 	}
 
-	OnFinishLoadZone(Index);
-	VdInfoPtr->ClearInstanceObjectMap();
-}
+	for (auto It = FarTerrainMap.CreateIterator(); It; ++It) {
+		if (!FarTerrainRequired.Contains(It.Key())) {
+			if (It.Value()) {
+				It.Value()->DestroyComponent();
+			}
+			It.RemoveCurrent();
+		}
+	}
 
-void ASandboxTerrainController::OnFinishAsyncPhysicsCook(const TVoxelIndex& ZoneIndex) {
+	for (const auto& Itm : FarTerrainMap) {
+		std::shared_ptr<TFarTerrainMeshData>* CachedPtr = FarTerrainCache.Find(Itm.Key);
+		if (Itm.Value && CachedPtr && *CachedPtr) {
+			TBitArray<> CoveredCellMask;
+			ClcFarTerrainCoverage(Itm.Key, **CachedPtr, CoveredCellMask);
+			Itm.Value->SetCoveredCells(CoveredCellMask);
+		}
+	}
 
-}
+	for (auto It = FarTerrainCache.CreateIterator(); It; ++It) {
+		if (!CacheSet.Contains(It.Key())) {
+			It.RemoveCurrent();
+		}
+	}
 
+	for (const TVoxelIndex& RegionIndex : FarTerrainRequired) {
+		if (FarTerrainMap.Contains(RegionIndex) || FarTerrainPending.Contains(RegionIndex)) {
+			continue;
+		}
 
-FORCEINLINE float ASandboxTerrainController::ClcGroundLevel(const FVector& V) {
-	//return Generator->GroundLevelFuncLocal(V);
-	return 0;
+		std::shared_ptr<TFarTerrainMeshData>* CachedPtr = FarTerrainCache.Find(RegionIndex);
+		if (CachedPtr) {
+			SpawnFarTerrain(RegionIndex, *CachedPtr);
+			continue;
+		}
+
+		FarTerrainPending.Add(RegionIndex);
+		AddAsyncTask([=, this]() {
+			std::shared_ptr<TFarTerrainMeshData> MeshDataPtr = GenerateFarTerrainMesh(RegionIndex);
+
+			// after zones near player
+			const float Priority = ClcConveyorPriority(ClcRegionOrigin(RegionIndex));
+			AddTaskToConveyor([=, this]() {
+				FarTerrainPending.Remove(RegionIndex);
+				FarTerrainCache.Add(RegionIndex, MeshDataPtr);
+				if (FarTerrainRequired.Contains(RegionIndex) && !FarTerrainMap.Contains(RegionIndex)) {
+					SpawnFarTerrain(RegionIndex, MeshDataPtr);
+				}
+			}, TConveyorTaskClass::Spawn, Priority);
+		});
+	}
 }
 
 //======================================================================================================================================================================
-// virtual functions
+// zone batching
 //======================================================================================================================================================================
 
+// always in game thread. cell is batched when selected lod of all its zones is not finer than batch lod
+void ASandboxTerrainController::UpdateZoneBatches() {
+	if (!bEnableZoneBatching || !bPrecomputedLodTransitions || !USBT_ENABLE_LOD || GetNetMode() == NM_DedicatedServer) {
+		return;
+	}
 
-void ASandboxTerrainController::OnOverlapActorTerrainEdit(const FOverlapResult& OverlapResult, const FVector& Pos) {
+	std::vector<std::pair<TVoxelIndex, std::unordered_set<TVoxelIndex>>> CellList;
+	TerrainData->ForEachZoneGridCell([&](const TVoxelIndex& Cell, const std::unordered_set<TVoxelIndex>& ZoneSet) {
+		CellList.push_back({ Cell, ZoneSet });
+	});
 
-}
+	TSet<TVoxelIndex> Required;
+	std::vector<std::pair<TVoxelIndex, std::unordered_set<TVoxelIndex>>> BuildList;
+	const double Now = FPlatformTime::Seconds();
 
-void ASandboxTerrainController::OnFinishGenerateNewZone(const TVoxelIndex& Index) {
+	for (const auto& Itm : CellList) {
+		const TVoxelIndex& Cell = Itm.first;
+		const bool bBatched = ZoneBatchMap.Contains(Cell);
+		const bool bPending = ZoneBatchPending.Contains(Cell);
 
-}
+		// hysteresis: lod ring edge moving over cell doesn't remove and create batch again
+		const int32 MinLod = (bBatched || bPending) ? FMath::Max((int32)ZoneBatchLod - 1, 0) : (int32)ZoneBatchLod;
 
-bool ASandboxTerrainController::OnZoneSoftUnload(const TVoxelIndex& ZoneIndex) {
-	return true;
-}
+		// lod state is not selected yet: -1
+		bool bCoarse = true;
+		int MeshCount = 0;
+		for (const TVoxelIndex& ZoneIndex : Itm.second) {
+			UTerrainZoneComponent* Zone = GetZoneByVectorIndex(ZoneIndex);
+			if (!Zone || !Zone->MainTerrainMesh || !Zone->MainTerrainMesh->GetMeshData()) {
+				continue;
+			}
 
-void ASandboxTerrainController::OnRestoreZoneSoftUnload(const TVoxelIndex& ZoneIndex) {
+			if (Zone->MainTerrainMesh->FixedLodIndex < MinLod) {
+				bCoarse = false;
+				break;
+			}
 
-}
+			MeshCount++;
+		}
 
-bool ASandboxTerrainController::OnZoneHardUnload(const TVoxelIndex& ZoneIndex) {
-	return true;
-}
+		if (!bCoarse || MeshCount == 0) {
+			continue;
+		}
+
+		Required.Add(Cell);
+		if (bPending) {
+			continue;
+		}
+
+		// changes in dirty cell are collected during rebuild delay
+		const double* DirtyTimePtr = ZoneBatchDirty.Find(Cell);
+		if (!bBatched || (DirtyTimePtr && Now - *DirtyTimePtr >= ZoneBatchRebuildDelay)) {
+			BuildList.push_back(Itm);
+		}
+	}
+
+	ZoneBatchRequired = Required;
+
+	TArray<TVoxelIndex> RemoveList;
+	for (const auto& Itm : ZoneBatchMap) {
+		if (!ZoneBatchRequired.Contains(Itm.Key)) {
+			RemoveList.Add(Itm.Key);
+		}
+	}
+
+	for (const TVoxelIndex& Cell : RemoveList) {
+		RemoveZoneBatch(Cell);
+	}
+
+	for (const auto& Itm : BuildList) {
+		StartZoneBatchBuild(Itm.first, Itm.second);
+	}
+}
+
+void ASandboxTerrainController::StartZoneBatchBuild(const TVoxelIndex& Cell, const std::unordered_set<TVoxelIndex>& ZoneSet) {
+	TArray<TZoneBatchItem> ZoneList;
+	for (const TVoxelIndex& ZoneIndex : ZoneSet) {
+		UTerrainZoneComponent* Zone = GetZoneByVectorIndex(ZoneIndex);
+		if (Zone && Zone->MainTerrainMesh) {
+			TMeshDataPtr MeshDataPtr = Zone->MainTerrainMesh->GetMeshData();
+			if (MeshDataPtr) {
+				TZoneBatchItem Item;
+				Item.ZoneIndex = ZoneIndex;
+				Item.MeshDataPtr = MeshDataPtr;
+				Item.LodIndex = Zone->MainTerrainMesh->FixedLodIndex;
+				Item.PatchMask = Zone->MainTerrainMesh->TransitionPatchMask;
+				ZoneList.Add(Item);
+			}
+		}
+	}
+
+	ZoneBatchDirty.Remove(Cell);
+	ZoneBatchPending.Add(Cell);
+
+	AddAsyncTask([=, this]() {
+		std::shared_ptr<TZoneBatchMeshData> MeshDataPtr = BuildZoneBatchMesh(Cell, ZoneList);
+
+		const int N = TTerrainData::ZoneGridCellSize;
+		const float Priority = ClcConveyorPriority(TVoxelIndex(Cell.X * N, Cell.Y * N, 0));
+		AddTaskToConveyor([=, this]() {
+			ZoneBatchPending.Remove(Cell);
+
+			// changed while building: mesh is stale, rebuilt on next update
+			if (ZoneBatchRequired.Contains(Cell) && !ZoneBatchDirty.Contains(Cell)) {
+				SpawnZoneBatch(Cell, MeshDataPtr);
+			}
+		}, TConveyorTaskClass::Spawn, Priority);
+	});
+}
+
+// any thread. mesh data of zones is read only. each zone goes with its selected lod and transition patches,
+// so batch is drawn as its zones and matches neighbors of any lod out of cell
+std::shared_ptr<TZoneBatchMeshData> ASandboxTerrainController::BuildZoneBatchMesh(const TVoxelIndex& Cell, const TArray<TZoneBatchItem>& ZoneList) {
+	const int N = TTerrainData::ZoneGridCellSize;
+	const FVector Origin = GetZonePos(TVoxelIndex(Cell.X * N, Cell.Y * N, 0));
+	const bool bMergeMaterials = IsMergedLodSections();
+	const FVector ZoneExtend(USBT_ZONE_SIZE / 2);
+
+	TZoneBatchMeshDataPtr MeshDataPtr = std::make_shared<TZoneBatchMeshData>();
+	TArray<std::shared_ptr<TMeshRenderSection>> RenderSectionArray;
+
+	// key: 0 - regular material, 1 - transition code, 2 - merged section
+	std::map<std::pair<int, uint64>, int32> SectionIndexMap;
+	auto FindOrAddSection = [&](const int Type, const uint64 Code) -> int32 {
+		const auto Key = std::make_pair(Type, Code);
+		auto It = SectionIndexMap.find(Key);
+		if (It != SectionIndexMap.end()) {
+			return It->second;
+		}
+
+		const int32 Idx = MeshDataPtr->SectionArray.AddDefaulted();
+		RenderSectionArray.Add(std::make_shared<TMeshRenderSection>());
+		SectionIndexMap.emplace(Key, Idx);
+		return Idx;
+	};
+
+	auto AppendContainer = [&](const TMeshContainer& Container, const TPackedVertexVector& Offset) {
+		if (bMergeMaterials) {
+			if (Container.MergedRenderSection) {
+				const int32 Idx = FindOrAddSection(2, 0);
+				MeshDataPtr->SectionArray[Idx].bMerged = true;
+				AppendMeshRenderSection(*RenderSectionArray[Idx], *Container.MergedRenderSection, Offset);
+			}
+
+			return;
+		}
+
+		for (const auto& Element : Container.MaterialSectionMap) {
+			if (Element.Value.RenderSection) {
+				const int32 Idx = FindOrAddSection(0, Element.Value.MaterialId);
+				MeshDataPtr->SectionArray[Idx].MaterialId = Element.Value.MaterialId;
+				AppendMeshRenderSection(*RenderSectionArray[Idx], *Element.Value.RenderSection, Offset);
+			}
+		}
+
+		for (const auto& Element : Container.MaterialTransitionSectionMap) {
+			if (Element.Value.RenderSection) {
+				const int32 Idx = FindOrAddSection(1, TMeshMaterialTransitionSection::GenerateTransitionCode(Element.Value.MaterialIdSet));
+				MeshDataPtr->SectionArray[Idx].bTransition = true;
+				MeshDataPtr->SectionArray[Idx].MaterialIdSet = Element.Value.MaterialIdSet;
+				AppendMeshRenderSection(*RenderSectionArray[Idx], *Element.Value.RenderSection, Offset);
+			}
+		}
+	};
+
+	for (const TZoneBatchItem& Itm : ZoneList) {
+		const TMeshDataPtr& ZoneMeshDataPtr = Itm.MeshDataPtr;
+
+		// render sections of zone can be built by other thread at same time
+		ZoneMeshDataPtr->ReadRenderData(bMergeMaterials, [&]() {
+			// as zone proxy: nearest lod to selected which has mesh. without lod generation only lod 0 exists
+			int32 LodIndex = -1;
+			for (int Lod = FMath::Clamp(Itm.LodIndex, 0, LOD_ARRAY_SIZE - 1); Lod >= 0; Lod--) {
+				const TMeshContainer& LodContainer = ZoneMeshDataPtr->MeshSectionLodArray[Lod].RegularMeshContainer;
+				if (LodContainer.MaterialSectionMap.Num() > 0 || LodContainer.MaterialTransitionSectionMap.Num() > 0) {
+					LodIndex = Lod;
+					break;
+				}
+			}
+
+			if (LodIndex < 0) {
+				return;
+			}
+
+			const FVector ZoneOffset = GetZonePos(Itm.ZoneIndex) - Origin;
+			const TPackedVertexVector Offset(ZoneOffset);
+			const TMeshLodSection& LodSection = ZoneMeshDataPtr->MeshSectionLodArray[LodIndex];
+
+			AppendContainer(LodSection.RegularMeshContainer, Offset);
+
+			// patches to neighbors with finer lod, same mask as zone proxy draws
+			if (LodIndex > 0) {
+				for (int I = 0; I < LodSection.TransitionPatchArray.Num(); I++) {
+					if (Itm.PatchMask & (1 << I)) {
+						AppendContainer(LodSection.TransitionPatchArray[I], Offset);
+					}
+				}
+			}
+
+			MeshDataPtr->LocalBox += FBox(ZoneOffset - ZoneExtend, ZoneOffset + ZoneExtend);
+			MeshDataPtr->ZoneCount++;
+		});
+	}
+
+	for (int32 Idx = 0; Idx < MeshDataPtr->SectionArray.Num(); Idx++) {
+		MeshDataPtr->SectionArray[Idx].RenderSection = RenderSectionArray[Idx];
+	}
+
+	return MeshDataPtr;
+}
+
+// zones are hidden later, when batch proxy exists
+void ASandboxTerrainController::SpawnZoneBatch(const TVoxelIndex& Cell, std::shared_ptr<TZoneBatchMeshData> MeshDataPtr) {
+	UTerrainBatchComponent** ExistingPtr = ZoneBatchMap.Find(Cell);
+	UTerrainBatchComponent* Batch = ExistingPtr ? *ExistingPtr : nullptr;
+
+	if (!MeshDataPtr || MeshDataPtr->SectionArray.Num() == 0) {
+		if (Batch) {
+			SetZoneBatchHidden(Cell, false);
+			Batch->DestroyComponent();
+		}
+
+		ZoneBatchMap.Remove(Cell);
+		ZoneBatchSwap.Remove(Cell);
+		return;
+	}
+
+	if (!Batch) {
+		const FString Name = FString::Printf(TEXT("ZoneBatch [%d, %d]"), Cell.X, Cell.Y);
+		Batch = NewObject<UTerrainBatchComponent>(this, MakeUniqueObjectName(this, UTerrainBatchComponent::StaticClass(), FName(*Name)));
+		if (!Batch) {
+			return;
+		}
+
+		const int N = TTerrainData::ZoneGridCellSize;
+		Batch->CellIndex = Cell;
+		Batch->RegisterComponent();
+		Batch->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepRelativeTransform, NAME_None);
+		Batch->SetWorldLocation(GetZonePos(TVoxelIndex(Cell.X * N, Cell.Y * N, 0)));
+	}
+
+	TArray<UMaterialInterface*> MaterialArray;
+	for (const TZoneBatchSection& Section : MeshDataPtr->SectionArray) {
+		if (Section.bMerged) {
+			MaterialArray.Add(MergedMaterial);
+		} else if (Section.bTransition) {
+			MaterialArray.Add(GetTransitionMaterial(Section.MaterialIdSet));
+		} else {
+			MaterialArray.Add(GetRegularTerrainMaterial(Section.MaterialId));
+		}
+	}
+
+	Batch->SetBatchMeshData(MeshDataPtr, MaterialArray);
+	Batch->SetVisibility(true);
+	ZoneBatchMap.Add(Cell, Batch);
+	ZoneBatchSwap.Add(Cell, GFrameCounter);
+}
+
+void ASandboxTerrainController::RemoveZoneBatch(const TVoxelIndex& Cell) {
+	UTerrainBatchComponent** BatchPtr = ZoneBatchMap.Find(Cell);
+	if (BatchPtr) {
+		SetZoneBatchHidden(Cell, false);
+		if (*BatchPtr) {
+			(*BatchPtr)->DestroyComponent();
+		}
+	}
+
+	ZoneBatchMap.Remove(Cell);
+	ZoneBatchDirty.Remove(Cell);
+	ZoneBatchSwap.Remove(Cell);
+}
+
+// render only, pushed to existing zone proxies. collision of zones is kept
+void ASandboxTerrainController::SetZoneBatchHidden(const TVoxelIndex& Cell, const bool bHidden) {
+	for (const TVoxelIndex& ZoneIndex : TerrainData->GetZoneGridCell(Cell)) {
+		UTerrainZoneComponent* Zone = GetZoneByVectorIndex(ZoneIndex);
+		if (Zone && Zone->MainTerrainMesh) {
+			Zone->MainTerrainMesh->SetBatched(bHidden);
+		}
+	}
+}
+
+// game thread. render state of batch is created at end of frame of spawn, zones and batch overlap at most one frame
+void ASandboxTerrainController::UpdateZoneBatchSwap() {
+	if (ZoneBatchSwap.Num() == 0) {
+		return;
+	}
+
+	TArray<TVoxelIndex> DoneList;
+	for (const auto& Itm : ZoneBatchSwap) {
+		UTerrainBatchComponent** BatchPtr = ZoneBatchMap.Find(Itm.Key);
+		if (!BatchPtr || !*BatchPtr) {
+			DoneList.Add(Itm.Key);
+			continue;
+		}
+
+		if (GFrameCounter > Itm.Value && (*BatchPtr)->SceneProxy) {
+			SetZoneBatchHidden(Itm.Key, true);
+			DoneList.Add(Itm.Key);
+		}
+	}
+
+	for (const TVoxelIndex& Cell : DoneList) {
+		ZoneBatchSwap.Remove(Cell);
+	}
+}
+
+// game thread. stale batch is hidden and zones of cell are drawn until batch is rebuilt
+void ASandboxTerrainController::MarkZoneBatchDirty(const TVoxelIndex& ZoneIndex) {
+	if (!bEnableZoneBatching) {
+		return;
+	}
+
+	const TVoxelIndex Cell = TTerrainData::ClcZoneGridCell(ZoneIndex);
+	if (ZoneBatchDirty.Contains(Cell)) {
+		return;
+	}
+
+	UTerrainBatchComponent** BatchPtr = ZoneBatchMap.Find(Cell);
+	if (BatchPtr) {
+		ZoneBatchDirty.Add(Cell, FPlatformTime::Seconds());
+		ZoneBatchSwap.Remove(Cell);
+		SetZoneBatchHidden(Cell, false);
+		if (*BatchPtr) {
+			(*BatchPtr)->SetVisibility(false);
+		}
+	} else if (ZoneBatchPending.Contains(Cell)) {
+		ZoneBatchDirty.Add(Cell, FPlatformTime::Seconds());
+	}
+}
+
+//======================================================================================================================================================================
+// zone lod state
+//======================================================================================================================================================================
+
+// game thread. lod state depends only on zone position, so it changes only when view moves
+void ASandboxTerrainController::UpdateZoneLods() {
+	if (!bPrecomputedLodTransitions || !USBT_ENABLE_LOD || GetNetMode() == NM_DedicatedServer) {
+		return;
+	}
+
+	FVector2D ViewportSize(1.f, 1.f);
+	if (GEngine && GEngine->GameViewport) {
+		GEngine->GameViewport->GetViewportSize(ViewportSize);
+	}
+
+	// split screen: each local player has own view. zone takes finest lod of all views
+	TArray<FVector4> ViewList;
+	for (auto Iterator = GetWorld()->GetPlayerControllerIterator(); Iterator; ++Iterator) {
+		APlayerController* PlayerController = Iterator->Get();
+		if (!PlayerController || !PlayerController->IsLocalController() || !PlayerController->PlayerCameraManager) {
+			continue;
+		}
+
+		FVector2D ViewSize = ViewportSize;
+		const ULocalPlayer* LocalPlayer = PlayerController->GetLocalPlayer();
+		if (LocalPlayer) {
+			ViewSize *= LocalPlayer->Size;
+		}
+
+		const FVector ViewPos = PlayerController->PlayerCameraManager->GetCameraLocation();
+		const float Fov = PlayerController->PlayerCameraManager->GetFOVAngle();
+
+		// as max projection scale in ComputeBoundsScreenSize with horizontal fov
+		const float AspectRatio = (ViewSize.Y > 0) ? FMath::Max(1.f, (float)(ViewSize.X / ViewSize.Y)) : 1.f;
+		const float ScreenMultiple = 0.5f * AspectRatio / FMath::Tan(FMath::DegreesToRadians(Fov * 0.5f));
+		ViewList.Add(FVector4(ViewPos, ScreenMultiple));
+	}
+
+	if (ViewList.Num() == 0) {
+		return;
+	}
+
+	const float Threshold = USBT_ZONE_SIZE * 0.1f;
+	bool bViewChanged = ViewList.Num() != ZoneLodViewList.Num();
+	for (int I = 0; I < ViewList.Num() && !bViewChanged; I++) {
+		const FVector4& View = ViewList[I];
+		const FVector4& LastView = ZoneLodViewList[I];
+		bViewChanged = FVector::DistSquared(FVector(View), FVector(LastView)) >= Threshold * Threshold || !FMath::IsNearlyEqual(View.W, LastView.W, 0.001f);
+	}
+
+	if (!bViewChanged) {
+		return;
+	}
+
+	ZoneLodViewList = ViewList;
+
+	TArray<TVoxelIndex> ZoneIndexList;
+	TerrainData->ForEachZoneGridCell([&](const TVoxelIndex& Cell, const std::unordered_set<TVoxelIndex>& ZoneSet) {
+		for (const TVoxelIndex& ZoneIndex : ZoneSet) {
+			ZoneIndexList.Add(ZoneIndex);
+		}
+	});
+
+	for (const TVoxelIndex& ZoneIndex : ZoneIndexList) {
+		UTerrainZoneComponent* Zone = GetZoneByVectorIndex(ZoneIndex);
+		if (Zone) {
+			ApplyZoneLodState(ZoneIndex, Zone->MainTerrainMesh);
+		}
+	}
+}
+
+// same selection as screen size lod of zone proxy, zone bounds sphere. largest screen size of all views
+int32 ASandboxTerrainController::ClcZoneLod(const FVector& ZonePos) const {
+	static const float ZoneRadius = USBT_ZONE_SIZE * 0.5f * 1.7320508f;
+
+	float ScreenSize = 0;
+	for (const FVector4& View : ZoneLodViewList) {
+		const float Dist = FMath::Max(1.f, (float)FVector::Dist(ZonePos, FVector(View)));
+		ScreenSize = FMath::Max(ScreenSize, 2.f * View.W * ZoneRadius / Dist);
+	}
+
+	int32 Lod = 0;
+	for (int LodIdx = 0; LodIdx < LOD_ARRAY_SIZE; LodIdx++) {
+		if (ScreenSize < LodScreenSizeArray[LodIdx]) {
+			Lod = LodIdx;
+		}
+	}
+
+	return Lod;
+}
+
+// patch to each neighbor with finer lod. neighbor lod is taken by position, loaded or not
+void ASandboxTerrainController::ApplyZoneLodState(const TVoxelIndex& ZoneIndex, UVoxelMeshComponent* MeshComponent) {
+	if (!MeshComponent || !bPrecomputedLodTransitions || ZoneLodViewList.Num() == 0) {
+		return;
+	}
+
+	// same order as transition patches: -X, +X, -Y, +Y, -Z, +Z
+	static const TVoxelIndex NeighborDir[6] = {
+		TVoxelIndex(-1, 0, 0), TVoxelIndex(1, 0, 0),
+		TVoxelIndex(0, -1, 0), TVoxelIndex(0, 1, 0),
+		TVoxelIndex(0, 0, -1), TVoxelIndex(0, 0, 1),
+	};
+
+	const int32 Lod = ClcZoneLod(GetZonePos(ZoneIndex));
+
+	uint8 PatchMask = 0;
+	for (int I = 0; I < 6 && Lod > 0; I++) {
+		if (ClcZoneLod(GetZonePos(ZoneIndex + NeighborDir[I])) < Lod) {
+			PatchMask |= (1 << I);
+		}
+	}
+
+	// batch of cell is drawn with previous lod state
+	if (MeshComponent->FixedLodIndex != Lod || MeshComponent->TransitionPatchMask != PatchMask) {
+		MeshComponent->SetLodState(Lod, PatchMask);
+		MarkZoneBatchDirty(ZoneIndex);
+	}
+}
+
+//======================================================================================================================================================================
+// zone occlusion
+//======================================================================================================================================================================
+
+// game thread. segment from view to zone passes only zones sharing face, edge or corner, and fully solid zone
+// stops it. so zone not reachable from view zone by 26-neighbor fill through not solid zones can't be seen.
+// area box is convex: segment between two zones of box never leaves it, zones outside are not checked
+void ASandboxTerrainController::UpdateZoneOcclusion() {
+	if (!bEnableZoneOcclusion || GetNetMode() == NM_DedicatedServer) {
+		return;
+	}
+
+	APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	if (!PlayerController || !PlayerController->PlayerCameraManager) {
+		return;
+	}
+
+	const TVoxelIndex ViewZone = GetZoneIndex(PlayerController->PlayerCameraManager->GetCameraLocation());
+	const double Now = FPlatformTime::Seconds();
+
+	// zones are applied almost every frame while streaming
+	if (ViewZone == ZoneOcclusionViewZone && (!bZoneOcclusionDirty || Now - ZoneOcclusionTime < 0.1)) {
+		return;
+	}
+
+	ZoneOcclusionViewZone = ViewZone;
+	ZoneOcclusionTime = Now;
+	bZoneOcclusionDirty = false;
+
+	const int RX = ActiveAreaSize + 1;
+	const int RZ = ActiveAreaDepth + 1;
+	const int SX = RX * 2 + 1;
+	const int SZ = RZ * 2 + 1;
+
+	auto IsInBox = [&](const TVoxelIndex& P) {
+		return FMath::Abs(P.X) <= RX && FMath::Abs(P.Y) <= RX && FMath::Abs(P.Z) <= RZ;
+	};
+
+	auto ClcBoxIdx = [&](const TVoxelIndex& P) {
+		return (P.X + RX) + (P.Y + RX) * SX + (P.Z + RZ) * SX * SX;
+	};
+
+	auto IsSolid = [&](const TVoxelIndex& ZoneIndex) {
+		TVoxelDataInfoPtr VdInfoPtr = TerrainData->FindVoxelDataInfo(ZoneIndex);
+		return VdInfoPtr && VdInfoPtr->GetFlagInternal() == 2;
+	};
+
+	TArray<bool> Reached;
+	Reached.SetNumZeroed(SX * SX * SZ);
+
+	TArray<TVoxelIndex> Stack;
+	Stack.Add(TVoxelIndex(0, 0, 0));
+	Reached[ClcBoxIdx(TVoxelIndex(0, 0, 0))] = true;
+
+	while (Stack.Num() > 0) {
+		const TVoxelIndex P = Stack.Pop(false);
+
+		// solid zone is reached but not passed. view zone itself is always passed
+		if (!(P == TVoxelIndex(0, 0, 0)) && IsSolid(ViewZone + P)) {
+			continue;
+		}
+
+		for (int X = -1; X <= 1; X++) {
+			for (int Y = -1; Y <= 1; Y++) {
+				for (int Z = -1; Z <= 1; Z++) {
+					const TVoxelIndex N = P + TVoxelIndex(X, Y, Z);
+					if (IsInBox(N) && !Reached[ClcBoxIdx(N)]) {
+						Reached[ClcBoxIdx(N)] = true;
+						Stack.Add(N);
+					}
+				}
+			}
+		}
+	}
+
+	TArray<TVoxelIndex> ZoneIndexList;
+	TerrainData->ForEachZoneGridCell([&](const TVoxelIndex& Cell, const std::unordered_set<TVoxelIndex>& ZoneSet) {
+		for (const TVoxelIndex& ZoneIndex : ZoneSet) {
+			ZoneIndexList.Add(ZoneIndex);
+		}
+	});
+
+	OccludedZoneSet.Empty();
+	for (const TVoxelIndex& ZoneIndex : ZoneIndexList) {
+		const TVoxelIndex P = ZoneIndex - ViewZone;
+		if (IsInBox(P) && !Reached[ClcBoxIdx(P)]) {
+			OccludedZoneSet.Add(ZoneIndex);
+		}
+	}
+
+	for (const TVoxelIndex& ZoneIndex : ZoneIndexList) {
+		UTerrainZoneComponent* Zone = GetZoneByVectorIndex(ZoneIndex);
+		if (Zone) {
+			ApplyZoneOcclusion(ZoneIndex, Zone->MainTerrainMesh);
+		}
+	}
+}
+
+void ASandboxTerrainController::ApplyZoneOcclusion(const TVoxelIndex& ZoneIndex, UVoxelMeshComponent* MeshComponent) {
+	if (MeshComponent) {
+		MeshComponent->SetOccluded(bEnableZoneOcclusion && OccludedZoneSet.Contains(ZoneIndex));
+	}
+}
+
+//======================================================================================================================================================================
+// zone collision lod
+//======================================================================================================================================================================
+
+int32 ASandboxTerrainController::GetCollisionChunkSplit() const {
+	return FMath::Clamp((int32)CollisionChunkSplit, 1, 4);
+}
+
+// game thread. full detail collision only near players, ai pawns, simulating physics objects and anchor objects, coarse or none elsewhere
+void ASandboxTerrainController::UpdateZoneCollisionLods(const TArray<FVector>& PlayerLocationList) {
+	if (CollisionRadius == 0) {
+		return;
+	}
+
+	TArray<FVector> AnchorObjectList;
+	GetAnchorObjectsLocation(AnchorObjectList);
+
+	CollisionFocusList = PlayerLocationList;
+	CollisionFocusList.Append(AnchorObjectList);
+
+	// pawns without player and physics bodies fall through coarse or missing collision
+	for (TActorIterator<AActor> ActorItr(GetWorld()); ActorItr; ++ActorItr) {
+		AActor* Actor = *ActorItr;
+		if (!Actor || Actor == this) {
+			continue;
+		}
+
+		const APawn* Pawn = Cast<APawn>(Actor);
+		if (Pawn) {
+			if (!Pawn->IsPlayerControlled()) {
+				CollisionFocusList.Add(Pawn->GetActorLocation());
+			}
+			continue;
+		}
+
+		const UPrimitiveComponent* Primitive = Cast<UPrimitiveComponent>(Actor->GetRootComponent());
+		if (Primitive && Primitive->IsSimulatingPhysics()) {
+			CollisionFocusList.Add(Primitive->GetComponentLocation());
+		}
+	}
+
+	TArray<TVoxelIndex> ZoneIndexList;
+	TerrainData->ForEachZoneGridCell([&](const TVoxelIndex& Cell, const std::unordered_set<TVoxelIndex>& ZoneSet) {
+		for (const TVoxelIndex& ZoneIndex : ZoneSet) {
+			ZoneIndexList.Add(ZoneIndex);
+		}
+	});
+
+	for (const TVoxelIndex& ZoneIndex : ZoneIndexList) {
+		UTerrainZoneComponent* Zone = GetZoneByVectorIndex(ZoneIndex);
+		if (Zone) {
+			ApplyZoneCollisionLod(ZoneIndex, Zone->MainTerrainMesh);
+		}
+	}
+}
+
+// full detail zone is kept a bit farther to avoid cooking again on small moves
+int32 ASandboxTerrainController::ClcZoneCollisionLod(const TVoxelIndex& ZoneIndex, const int32 CurrentLod) {
+	if (CollisionRadius == 0 || CollisionFocusList.Num() == 0) {
+		return 0;
+	}
+
+	const float Radius = CollisionRadius * USBT_ZONE_SIZE * ((CurrentLod == 0) ? 1.25f : 1.f);
+	const FVector ZonePos = GetZonePos(ZoneIndex);
+	const FVector ZoneExtend(USBT_ZONE_SIZE / 2);
+	const FBox ZoneBox(ZonePos - ZoneExtend, ZonePos + ZoneExtend);
+
+	for (const FVector& Location : CollisionFocusList) {
+		if (ZoneBox.ComputeSquaredDistanceToPoint(Location) <= Radius * Radius) {
+			return 0;
+		}
+	}
+
+	return FMath::Min(CoarseCollisionLod, LOD_ARRAY_SIZE - 1);
+}
+
+void ASandboxTerrainController::ApplyZoneCollisionLod(const TVoxelIndex& ZoneIndex, UVoxelMeshComponent* MeshComponent) {
+	if (MeshComponent) {
+		MeshComponent->SetCollisionLod(ClcZoneCollisionLod(ZoneIndex, MeshComponent->GetCollisionLod()));
+	}
+}
+
+//======================================================================================================================================================================
+// invoke async
+//======================================================================================================================================================================
+
+
+void ASandboxTerrainController::InvokeSafe(std::function<void()> Function) {
+    if (IsInGameThread()) {
+        Function();
+    } else {
+        AsyncTask(ENamedThreads::GameThread, [=]() { Function(); });
+    }
+}
+
+float ASandboxTerrainController::ClcConveyorPriority(const TVoxelIndex& Index) {
+	return CheckAreaMap->ClcFocusDistSquared(GetZonePos(Index));
+}
+
+bool ASandboxTerrainController::AddTaskToConveyor(std::function<void()> Function, const TConveyorTaskClass TaskClass, const float Priority) {
+	if (bEnableConveyor) {
+		Conveyor->push(Function, (int)TaskClass, Priority);
+	} else {
+		if (IsInGameThread()) {
+			Function();
+		} else {
+			UE_LOG(LogVt, Error, TEXT("Conveyor is disabled. Attempt to run conveyor task in non game thread"));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void ASandboxTerrainController::ExecGameThreadZoneApplyMesh(const TVoxelIndex& Index, UTerrainZoneComponent* Zone, TMeshDataPtr MeshDataPtr, const bool bIsChanged) {
+	if (!MeshDataPtr) {
+		return;
+	}
+
+	// zone is fetched again on apply. it can be unloaded or reused while task is in queue
+	TZoneApplyItem Item;
+	Item.MeshDataPtr = MeshDataPtr;
+	Item.bNeedSave = true;
+	Item.TaskClass = bIsChanged ? TConveyorTaskClass::Edit : TConveyorTaskClass::Mesh;
+	Item.Priority = ClcConveyorPriority(Index);
+	QueueZoneApply(Index, Item);
+}
+
+void ASandboxTerrainController::ExecGameThreadAddZoneAndApplyMesh(const TVoxelIndex& Index, TMeshDataPtr MeshDataPtr, const bool bIsNewGenerated, const bool bIsChanged) {
+	if (!MeshDataPtr) {
+		return;
+	}
+
+	TZoneApplyItem Item;
+	Item.MeshDataPtr = MeshDataPtr;
+	Item.bAddZone = true;
+	Item.bIsNewGenerated = bIsNewGenerated;
+	Item.bIsChanged = bIsChanged;
+	Item.bNeedSave = bIsChanged;
+	Item.TaskClass = bIsChanged ? TConveyorTaskClass::Edit : TConveyorTaskClass::Mesh;
+	Item.Priority = ClcConveyorPriority(Index);
+	QueueZoneApply(Index, Item);
+}
+
+// any thread. zone already in queue gets newer mesh and merged flags instead of new task
+void ASandboxTerrainController::QueueZoneApply(const TVoxelIndex& Index, const TZoneApplyItem& NewItem) {
+	// on worker which meshed or loaded zone. game thread apply gets ready render buffers
+	NewItem.MeshDataPtr->PrepareRenderData(IsMergedLodSections());
+	RegisterTransitionMaterials(*NewItem.MeshDataPtr);
+
+	// and collision chunks with crc of both collision lods. game thread only compares crc and cooks changed chunks
+	const int32 Split = GetCollisionChunkSplit();
+	if (Split > 1) {
+		NewItem.MeshDataPtr->PrepareCollisionChunks(Split, 0);
+		if (CollisionRadius > 0 && CoarseCollisionLod > 0) {
+			NewItem.MeshDataPtr->PrepareCollisionChunks(Split, CoarseCollisionLod);
+		}
+	}
+
+	bool bPushTask = false;
+	TConveyorTaskClass TaskClass;
+
+	{
+		const std::lock_guard<std::mutex> Lock(ZoneApplyMutex);
+
+		auto It = ZoneApplyMap.find(Index);
+		if (It == ZoneApplyMap.end()) {
+			It = ZoneApplyMap.emplace(Index, NewItem).first;
+		} else {
+			TZoneApplyItem& Item = It->second;
+			if (NewItem.MeshDataPtr->VStamp >= Item.MeshDataPtr->VStamp) {
+				Item.MeshDataPtr = NewItem.MeshDataPtr;
+			}
+
+			Item.bAddZone |= NewItem.bAddZone;
+			Item.bIsNewGenerated |= NewItem.bIsNewGenerated;
+			Item.bIsChanged |= NewItem.bIsChanged;
+			Item.bNeedSave |= NewItem.bNeedSave;
+			Item.TaskClass = (TConveyorTaskClass)FMath::Min((int)Item.TaskClass, (int)NewItem.TaskClass);
+			Item.Priority = FMath::Min(Item.Priority, NewItem.Priority);
+		}
+
+		TaskClass = It->second.TaskClass;
+		if (!bZoneApplyBatchQueued[(int)TaskClass]) {
+			bZoneApplyBatchQueued[(int)TaskClass] = true;
+			bPushTask = true;
+		}
+	}
+
+	if (bPushTask && !AddTaskToConveyor([=, this]() { ExecZoneApplyBatch(TaskClass); }, TaskClass)) {
+		// task dropped. next queued zone pushes it again
+		const std::lock_guard<std::mutex> Lock(ZoneApplyMutex);
+		bZoneApplyBatchQueued[(int)TaskClass] = false;
+	}
+}
+
+bool ASandboxTerrainController::IsZoneApplyQueued(const TVoxelIndex& Index) {
+	const std::lock_guard<std::mutex> Lock(ZoneApplyMutex);
+	return ZoneApplyMap.find(Index) != ZoneApplyMap.end();
+}
+
+void ASandboxTerrainController::CancelUnreachableZoneApply(const TArray<FVector>& PlayerLocationList, const TArray<FVector>& AnchorObjectList) {
+	const float RadiusKeepByPlayerPos = ActiveAreaSize * USBT_ZONE_SIZE * 1.5f;
+	const static float RadiusByAnchorObject = USBT_ZONE_SIZE * 1.4142; // sqrt(2)
+
+	TArray<TVoxelIndex> CancelList;
+
+	{
+		const std::lock_guard<std::mutex> Lock(ZoneApplyMutex);
+
+		for (auto It = ZoneApplyMap.begin(); It != ZoneApplyMap.end(); ) {
+			const TZoneApplyItem& Item = It->second;
+			if (!Item.bAddZone || Item.bNeedSave || Item.bIsNewGenerated || Item.bIsChanged) {
+				++It;
+				continue;
+			}
+
+			const FVector ZonePos = GetZonePos(It->first);
+
+			bool bReachable = false;
+			for (const auto& PlayerLocation : PlayerLocationList) {
+				if (FVector::Distance(ZonePos, PlayerLocation) < RadiusKeepByPlayerPos) {
+					bReachable = true;
+					break;
+				}
+			}
+
+			for (const auto& Location : AnchorObjectList) {
+				if (bReachable) {
+					break;
+				}
+
+				bReachable = FVector::Distance(ZonePos, Location) < RadiusByAnchorObject;
+			}
+
+			if (bReachable) {
+				++It;
+			} else {
+				CancelList.Add(It->first);
+				It = ZoneApplyMap.erase(It);
+			}
+		}
+	}
+
+	// zone was never added. allow to spawn it again
+	for (const TVoxelIndex& ZoneIndex : CancelList) {
+		TVoxelDataInfoPtr VdInfoPtr = TerrainData->GetVoxelDataInfo(ZoneIndex);
+		TVdInfoLockGuard Lock(VdInfoPtr);
+		if (GetZoneByVectorIndex(ZoneIndex) == nullptr) {
+			VdInfoPtr->ResetSpawnFinished();
+		}
+	}
+
+	if (CancelList.Num() > 0) {
+		UE_LOG(LogVt, Log, TEXT("Cancelled queued zone apply: %d"), CancelList.Num());
+	}
+}
+
+// game thread. nearest zones of task class first. zone count is limited by conveyor budget left in this frame
+// and measured cost per zone. components of new zones are created here, meshes are applied by next conveyor task
+void ASandboxTerrainController::ExecZoneApplyBatch(const TConveyorTaskClass TaskClass) {
+	if (bIsGameShutdown) {
+		return;
+	}
+
+	// cost is not measured yet: one zone
+	const double ZoneCost = FMath::Max(ZoneSpawnCost, ZoneApplyCost);
+	int32 MaxBatchSize = 1;
+	if (ZoneCost > 0) {
+		MaxBatchSize = FMath::Clamp((int32)((ConveyorBudget - ConveyorFrameTime) / ZoneCost), 1, FMath::Max(ZoneApplyBatchSize, 1));
+	}
+
+	std::vector<std::pair<TVoxelIndex, TZoneApplyItem>> Batch;
+	bool bRequeue = false;
+
+	{
+		const std::lock_guard<std::mutex> Lock(ZoneApplyMutex);
+
+		std::vector<std::pair<float, TVoxelIndex>> Candidates;
+		for (const auto& Itm : ZoneApplyMap) {
+			if (Itm.second.TaskClass == TaskClass) {
+				Candidates.push_back({ Itm.second.Priority, Itm.first });
+			}
+		}
+
+		const size_t BatchSize = std::min(Candidates.size(), (size_t)MaxBatchSize);
+		std::partial_sort(Candidates.begin(), Candidates.begin() + BatchSize, Candidates.end(), [](const auto& A, const auto& B) { return A.first < B.first; });
+
+		Batch.reserve(BatchSize);
+		for (size_t Idx = 0; Idx < BatchSize; Idx++) {
+			auto It = ZoneApplyMap.find(Candidates[Idx].second);
+			Batch.push_back({ It->first, It->second });
+			ZoneApplyMap.erase(It);
+		}
+
+		bRequeue = Candidates.size() > BatchSize;
+		bZoneApplyBatchQueued[(int)TaskClass] = bRequeue;
+	}
+
+	if (bRequeue && !AddTaskToConveyor([=, this]() { ExecZoneApplyBatch(TaskClass); }, TaskClass)) {
+		const std::lock_guard<std::mutex> Lock(ZoneApplyMutex);
+		bZoneApplyBatchQueued[(int)TaskClass] = false;
+	}
+
+	const double SpawnStart = FPlatformTime::Seconds();
+	int SpawnCount = 0;
+
+	for (const auto& Itm : Batch) {
+		if (Itm.second.bAddZone && !GetZoneByVectorIndex(Itm.first)) {
+			TVoxelDataInfoPtr VdInfoPtr = TerrainData->GetVoxelDataInfo(Itm.first);
+			TVdInfoLockGuard Lock(VdInfoPtr);
+			AddTerrainZone(GetZonePos(Itm.first));
+			SpawnCount++;
+		}
+	}
+
+	if (SpawnCount == 0) {
+		ExecZoneApplyMeshBatch(Batch);
+		return;
+	}
+
+	const double SpawnTime = (FPlatformTime::Seconds() - SpawnStart) / Batch.size();
+	ZoneSpawnCost = (ZoneSpawnCost == 0) ? SpawnTime : ZoneSpawnCost * 0.9 + SpawnTime * 0.1;
+
+	// second step in separate conveyor task: component creation and mesh apply are amortized across frames
+	const TConveyorTaskClass ApplyTaskClass = (TaskClass == TConveyorTaskClass::Edit) ? TConveyorTaskClass::Edit : TConveyorTaskClass::Mesh;
+	AddTaskToConveyor([=, this]() { ExecZoneApplyMeshBatch(Batch); }, ApplyTaskClass, Batch.front().second.Priority);
+}
+
+void ASandboxTerrainController::ExecZoneApplyMeshBatch(const std::vector<std::pair<TVoxelIndex, TZoneApplyItem>>& Batch) {
+	if (bIsGameShutdown) {
+		return;
+	}
+
+	const double ApplyStart = FPlatformTime::Seconds();
+
+	for (const auto& Itm : Batch) {
+		const TVoxelIndex& Index = Itm.first;
+		const TZoneApplyItem& Item = Itm.second;
+
+		TVoxelDataInfoPtr VdInfoPtr = TerrainData->GetVoxelDataInfo(Index);
+		TVdInfoLockGuard Lock(VdInfoPtr);
+
+		UTerrainZoneComponent* Zone = GetZoneByVectorIndex(Index);
+		if (Zone) {
+			// newer mesh can be applied by edit task between steps
+			TMeshDataPtr CurrentMeshDataPtr = Zone->MainTerrainMesh ? Zone->MainTerrainMesh->GetMeshData() : nullptr;
+			const bool bStale = CurrentMeshDataPtr && CurrentMeshDataPtr->VStamp > Item.MeshDataPtr->VStamp;
+
+			ApplyZoneLodState(Index, Zone->MainTerrainMesh);
+			ApplyZoneOcclusion(Index, Zone->MainTerrainMesh);
+			if (!bStale) {
+				ApplyTerrainMesh(Zone, Item.MeshDataPtr);
+			}
+
+			ApplyZoneCollisionLod(Index, Zone->MainTerrainMesh);
+			MarkZoneBatchDirty(Index);
+			bZoneOcclusionDirty = true;
+
+			if (Item.bNeedSave) {
+				TerrainData->PutMeshDataToCache(Index, Item.MeshDataPtr);
+				VdInfoPtr->SetNeedTerrainSave();
+				TerrainData->AddSaveIndex(Index);
+			}
+
+			if (Item.bAddZone) {
+				if (Item.bIsNewGenerated) {
+					OnGenerateNewZone(Index, Zone);
+				} else {
+					OnLoadZone(Index, Zone);
+				}
+			}
+		} else if (Item.bNeedSave || Item.bIsNewGenerated) {
+			// zone unloaded before apply. keep data
+			if (Item.bNeedSave) {
+				TerrainData->PutMeshDataToCache(Index, Item.MeshDataPtr);
+			}
+
+			VdInfoPtr->SetNeedTerrainSave();
+			TerrainData->AddSaveIndex(Index);
+		}
+	}
+
+	const double ApplyTime = (FPlatformTime::Seconds() - ApplyStart) / Batch.size();
+	ZoneApplyCost = (ZoneApplyCost == 0) ? ApplyTime : ZoneApplyCost * 0.9 + ApplyTime * 0.1;
+}
+
+void ASandboxTerrainController::AddAsyncTask(std::function<void()> Function, const bool bHiPrio, const uint64 TaskKey) {
+	ThreadPool->addTask(Function, bHiPrio, TaskKey);
+}
+
+//======================================================================================================================================================================
+// events
+//======================================================================================================================================================================
+
+void ASandboxTerrainController::OnGenerateNewZone(const TVoxelIndex& Index, UTerrainZoneComponent* Zone) {
+	TVoxelDataInfoPtr VdInfoPtr = TerrainData->GetVoxelDataInfo(Index);
+
+    if (FoliageDataAsset) {
+		TInstanceMeshTypeMap& ZoneInstanceObjectMap = *TerrainData->GetOrCreateInstanceObjectMap(Index);
+		Zone->SpawnAll(ZoneInstanceObjectMap);
+		VdInfoPtr->SetNeedObjectsSave();
+    }
+
+	OnFinishGenerateNewZone(Index);
+	VdInfoPtr->ClearInstanceObjectMap();
+	VdInfoPtr->SetNeedTerrainSave();
+	TerrainData->AddSaveIndex(Index);
+}
+
+void ASandboxTerrainController::OnLoadZone(const TVoxelIndex& Index, UTerrainZoneComponent* Zone) {
+	TVoxelDataInfoPtr VdInfoPtr = TerrainData->GetVoxelDataInfo(Index);
+
+	if (FoliageDataAsset) {
+		TInstanceMeshTypeMap& ZoneInstanceObjectMap = *TerrainData->GetOrCreateInstanceObjectMap(Index);
+		Zone->SpawnAll(ZoneInstanceObjectMap);
+	}
+
+	OnFinishLoadZone(Index);
+	VdInfoPtr->ClearInstanceObjectMap();
+}
+
+void ASandboxTerrainController::OnFinishAsyncPhysicsCook(const TVoxelIndex& ZoneIndex) {
+
+}
+
+
+FORCEINLINE float ASandboxTerrainController::ClcGroundLevel(const FVector& V) {
+	//return Generator->GroundLevelFuncLocal(V);
+	return 0;
+}
+
+//======================================================================================================================================================================
+// virtual functions
+//======================================================================================================================================================================
+
+
+void ASandboxTerrainController::OnOverlapActorTerrainEdit(const FOverlapResult& OverlapResult, const FVector& Pos) {
+
+}
+
+void ASandboxTerrainController::OnFinishGenerateNewZone(const TVoxelIndex& Index) {
+
+}
+
+bool ASandboxTerrainController::OnZoneSoftUnload(const TVoxelIndex& ZoneIndex) {
+	return true;
+}
+
+void ASandboxTerrainController::OnRestoreZoneSoftUnload(const TVoxelIndex& ZoneIndex) {
+
+}
+
+bool ASandboxTerrainController::OnZoneHardUnload(const TVoxelIndex& ZoneIndex) {
+	return true;
+}
 
 void ASandboxTerrainController::OnFinishLoadZone(const TVoxelIndex& Index) {
 
@@ -1288,6 +2764,10 @@ void ASandboxTerrainController::UE51MaterialIssueWorkaround() {
 	TArray<UTerrainZoneComponent*> Components;
 	GetComponents<UTerrainZoneComponent>(Components);
 	for (UTerrainZoneComponent* ZoneComponent : Components) {
+		if (ZoneComponent->IsPooled()) {
+			continue;
+		}
+
 		FVector ZonePos = ZoneComponent->GetComponentLocation();
 		const TVoxelIndex ZoneIndex = GetZoneIndex(ZonePos);
 
@@ -1302,6 +2782,8 @@ void ASandboxTerrainController::UE51MaterialIssueWorkaround() {
 		VdInfoPtr->Unlock();
 	}
 
+	bMaterialCreatedOnLoad = false;
+
 	double End = FPlatformTime::Seconds();
 	double Time = (End - Start) * 1000;
 	UE_LOG(LogVt, Log, TEXT("UE51MaterialIssueWorkaround --> %f ms"), Time);
@@ -2,9 +2,11 @@
 #include "SandboxTerrainController.h"
 #include "Core/VoxelDataInfo.hpp"
 #include "TerrainZoneComponent.h"
+#include "TerrainCollisionChunkComponent.h"
 #include "Core/TerrainData.hpp"
 #include "TerrainServerComponent.h"
 #include "Engine/OverlapResult.h"
+#include <bitset>
 
 
 struct TZoneEditHandler {
@@ -437,6 +439,29 @@ UVoxelMeshComponent* ASandboxTerrainController::GetVoxelMeshComponent(TVoxelInde
 	return nullptr;
 }
 
+uint16 ASandboxTerrainController::GetMaterialIdFromHit(const FHitResult& Hit) const {
+	const UPrimitiveComponent* Component = Hit.GetComponent();
+
+	const UVoxelMeshComponent* MeshComp = Cast<UVoxelMeshComponent>(Component);
+	if (MeshComp) {
+		return MeshComp->GetMaterialIdFromCollisionFaceIndex(Hit.FaceIndex);
+	}
+
+	const UTerrainCollisionChunkComponent* ChunkComp = Cast<UTerrainCollisionChunkComponent>(Component);
+	if (ChunkComp) {
+		return ChunkComp->GetMaterialIdFromCollisionFaceIndex(Hit.FaceIndex);
+	}
+
+	return 0;
+}
+
+void ASandboxTerrainController::GetMaterialIdsFromHits(const TArray<FHitResult>& HitArray, TArray<uint16>& OutMaterialIdArray) const {
+	OutMaterialIdArray.SetNumUninitialized(HitArray.Num());
+	for (int32 Idx = 0; Idx < HitArray.Num(); Idx++) {
+		OutMaterialIdArray[Idx] = GetMaterialIdFromHit(HitArray[Idx]);
+	}
+}
+
 
 void ASandboxTerrainNetProxy::MulticastRpcDestroyInstanceMesh_Implementation(int32 MapVer, int32 X, int32 Y, int32 Z, uint32 TypeId, uint32 VariantId, int32 ItemIndex) {
 	if (GetNetMode() == NM_Client) {
@@ -544,10 +569,29 @@ void ASandboxTerrainController::PerformEachZone(const FVector& Origin, const flo
 }
 
 template<class H>
-void ASandboxTerrainController::PerformZoneEditHandler(const TVoxelIndex& ZoneIndex, TVoxelDataInfoPtr VdInfoPtr, H Handler, std::function<void(TMeshDataPtr)> OnComplete) {
+void ASandboxTerrainController::PerformZoneEditHandler(const TVoxelIndex& ZoneIndex, TVoxelDataInfoPtr VdInfoPtr, H Handler) {
 	bool bIsChanged = Handler(VdInfoPtr->Vd);
 	//if (bIsChanged) {
 		VdInfoPtr->SetChanged();
+		QueueZoneRemesh(ZoneIndex);
+	//}
+}
+
+void ASandboxTerrainController::QueueZoneRemesh(const TVoxelIndex& ZoneIndex) {
+	// voxel data is already changed. remesh is keyed by zone, so not started remesh is reused by next edit
+	AddAsyncTask([=, this]() {
+		if (bIsWorkFinished) {
+			return;
+		}
+
+		TVoxelDataInfoPtr VdInfoPtr = GetVoxelDataInfo(ZoneIndex);
+		VdInfoPtr->Lock();
+
+		if (VdInfoPtr->Vd == nullptr) {
+			VdInfoPtr->Unlock();
+			return;
+		}
+
 		VdInfoPtr->Vd->setCacheToValid();
 		TMeshDataPtr MeshDataPtr = GenerateMesh(VdInfoPtr->Vd);
 		VdInfoPtr->ResetLastMeshRegenerationTime();
@@ -556,8 +600,38 @@ void ASandboxTerrainController::PerformZoneEditHandler(const TVoxelIndex& ZoneIn
 			MeshDataPtr->VStamp = TerrainData->GetZoneVStamp(ZoneIndex).VStamp;
 		}
 
-		OnComplete(MeshDataPtr);
-	//}
+		VdInfoPtr->Unlock();
+
+		UTerrainZoneComponent* Zone = GetZoneByVectorIndex(ZoneIndex);
+		if (Zone == nullptr) {
+			ExecGameThreadAddZoneAndApplyMesh(ZoneIndex, MeshDataPtr, false, true);
+		} else {
+			ExecGameThreadZoneApplyMesh(ZoneIndex, Zone, MeshDataPtr, true);
+		}
+	}, true, ClcAsyncTaskKey(TAsyncTaskType::ZoneRemesh, ZoneIndex));
+}
+
+bool ASandboxTerrainController::ResolveSkippedZoneForEdit(const TVoxelIndex& ZoneIndex, TVoxelDataInfoPtr VdInfoPtr) {
+	// zone which can have geometry is not skipped. it is still waiting for area loader
+	if (!bSurfaceStreaming || CheckZoneCanHaveGeometry(ZoneIndex)) {
+		return false;
+	}
+
+	TVdInfoLockGuard Lock(VdInfoPtr);
+	if (VdInfoPtr->DataState != TVoxelDataState::UNDEFINED) {
+		return true;
+	}
+
+	// same as zone spawn: saved voxel data is loaded, otherwise zone is generated in EditTerrain
+	TFileItmKey Key{ ZoneIndex, TFileItmType::MESH_DATA };
+	if (FKvdb::HasKey(DataFileId, Key)) {
+		std::bitset<sizeof(uint64)> ZoneFlags(FKvdb::GetKeyFlags(DataFileId, Key));
+		VdInfoPtr->DataState = ZoneFlags.test((size_t)TZoneFlag::NoVoxelData) ? TVoxelDataState::UNGENERATED : TVoxelDataState::READY_TO_LOAD;
+	} else {
+		VdInfoPtr->DataState = TVoxelDataState::UNGENERATED;
+	}
+
+	return true;
 }
 
 int32 ASandboxTerrainController::GetMapVStamp() {
@@ -575,7 +649,7 @@ void ASandboxTerrainController::EditTerrain(const H& ZoneHandler) {
 	bool bIsValid = true;
 
 	PerformEachZone(ZoneHandler.Origin, ZoneHandler.Extend, [&](TVoxelIndex ZoneIndex, FVector Origin, TVoxelDataInfoPtr VoxelDataInfo) {
-		if (VoxelDataInfo->DataState == TVoxelDataState::UNDEFINED) {
+		if (VoxelDataInfo->DataState == TVoxelDataState::UNDEFINED && !ResolveSkippedZoneForEdit(ZoneIndex, VoxelDataInfo)) {
 			UE_LOG(LogVt, Warning, TEXT("Zone: %d %d %d -> Invalid zone vd state (UNDEFINED)"), ZoneIndex.X, ZoneIndex.Y, ZoneIndex.Z);
 
 			AsyncTask(ENamedThreads::GameThread, [=]() {
@@ -592,7 +666,6 @@ void ASandboxTerrainController::EditTerrain(const H& ZoneHandler) {
 
 	PerformEachZone(ZoneHandler.Origin, ZoneHandler.Extend, [&](TVoxelIndex ZoneIndex, FVector Origin, TVoxelDataInfoPtr VoxelDataInfo) {
 		VoxelDataInfo->Lock();
-		UTerrainZoneComponent* Zone = GetZoneByVectorIndex(ZoneIndex);
 
 		if (VoxelDataInfo->DataState == TVoxelDataState::UNDEFINED) {
 			UE_LOG(LogVt, Warning, TEXT("Zone: %d %d %d -> UNDEFINED"), ZoneIndex.X, ZoneIndex.Y, ZoneIndex.Z);
@@ -632,15 +705,7 @@ void ASandboxTerrainController::EditTerrain(const H& ZoneHandler) {
 				TerrainData->IncreaseVStamp(ZoneIndex);
 			}
 
-			if (Zone == nullptr) {
-				PerformZoneEditHandler(ZoneIndex, VoxelDataInfo, ZoneHandler, [&](TMeshDataPtr MeshDataPtr) {
-					ExecGameThreadAddZoneAndApplyMesh(ZoneIndex, MeshDataPtr, false, true);
-				});
-			} else {
-				PerformZoneEditHandler(ZoneIndex, VoxelDataInfo, ZoneHandler, [&](TMeshDataPtr MeshDataPtr) {
-					ExecGameThreadZoneApplyMesh(ZoneIndex, Zone, MeshDataPtr);
-				});
-			}
+			PerformZoneEditHandler(ZoneIndex, VoxelDataInfo, ZoneHandler);
 		}
 
 		VoxelDataInfo->Unlock();
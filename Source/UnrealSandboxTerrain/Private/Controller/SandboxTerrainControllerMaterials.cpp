@@ -15,26 +15,57 @@ bool ASandboxTerrainController::GetTerrainMaterialInfoById(uint16 MaterialId, FS
 	return false;
 }
 
-UMaterialInterface* ASandboxTerrainController::GetRegularTerrainMaterial(uint16 MaterialId) {
-	if (RegularMaterial == nullptr) {
-		return nullptr;
+UMaterialInterface* ASandboxTerrainController::CreateRegularTerrainMaterial(uint16 MaterialId) {
+	UE_LOG(LogVt, Log, TEXT("create new regular terrain material instance -> id: %d"), MaterialId);
+	UMaterialInstanceDynamic* DynMaterial = UMaterialInstanceDynamic::Create(RegularMaterial, this);
+
+	if (MaterialMap.Contains(MaterialId)) {
+		FSandboxTerrainMaterial Mat = MaterialMap[MaterialId];
+		DynMaterial->SetTextureParameterValue("TextureDiffuse", Mat.TextureDiffuse);
+		DynMaterial->SetTextureParameterValue("TextureNormal", Mat.TextureNormal);
 	}
 
-	if (!RegularMaterialCache.Contains(MaterialId)) {
-		UE_LOG(LogVt, Log, TEXT("create new regular terrain material instance -> id: %d"), MaterialId);
-		UMaterialInstanceDynamic* DynMaterial = UMaterialInstanceDynamic::Create(RegularMaterial, this);
+	RegularMaterialCache.Add(MaterialId, DynMaterial);
+	return DynMaterial;
+}
 
-		if (MaterialMap.Contains(MaterialId)) {
-			FSandboxTerrainMaterial Mat = MaterialMap[MaterialId];
-			DynMaterial->SetTextureParameterValue("TextureDiffuse", Mat.TextureDiffuse);
-			DynMaterial->SetTextureParameterValue("TextureNormal", Mat.TextureNormal);
+UMaterialInterface* ASandboxTerrainController::CreateTransitionMaterial(uint64 Code, const std::set<unsigned short>& MaterialIdSet) {
+	TTransitionMaterialCode tmp;
+	tmp.Code = Code;
+
+	UE_LOG(LogVt, Log, TEXT("create new transition terrain material instance -> id: %llu (%lu-%lu-%lu)"), Code, tmp.TriangleMatId[0], tmp.TriangleMatId[1], tmp.TriangleMatId[2]);
+	UMaterialInstanceDynamic* DynMaterial = UMaterialInstanceDynamic::Create(TransitionMaterial, this);
+
+	int Idx = 0;
+	for (unsigned short MatId : MaterialIdSet) {
+		if (MaterialMap.Contains(MatId)) {
+			FSandboxTerrainMaterial Mat = MaterialMap[MatId];
+			FName TextureDiffuseParam = FName(*FString::Printf(TEXT("TextureDiffuse%d"), Idx));
+			FName TextureNormalParam = FName(*FString::Printf(TEXT("TextureNormal%d"), Idx));
+			DynMaterial->SetTextureParameterValue(TextureDiffuseParam, Mat.TextureDiffuse);
+			DynMaterial->SetTextureParameterValue(TextureNormalParam, Mat.TextureNormal);
 		}
 
-		RegularMaterialCache.Add(MaterialId, DynMaterial);
-		return DynMaterial;
+		Idx++;
+	}
+
+	TransitionMaterialCache.Add(Code, DynMaterial);
+	return DynMaterial;
+}
+
+UMaterialInterface* ASandboxTerrainController::GetRegularTerrainMaterial(uint16 MaterialId) {
+	if (RegularMaterial == nullptr) {
+		return nullptr;
+	}
+
+	UMaterialInterface** MaterialPtr = RegularMaterialCache.Find(MaterialId);
+	if (MaterialPtr) {
+		return *MaterialPtr;
 	}
 
-	return RegularMaterialCache[MaterialId];
+	// id is not in material map
+	bMaterialCreatedOnLoad = true;
+	return CreateRegularTerrainMaterial(MaterialId);
 }
 
 UMaterialInterface* ASandboxTerrainController::GetTransitionMaterial(const std::set<unsigned short>& MaterialIdSet) {
@@ -43,29 +74,101 @@ UMaterialInterface* ASandboxTerrainController::GetTransitionMaterial(const std::
 	}
 
 	uint64 Code = TMeshMaterialTransitionSection::GenerateTransitionCode(MaterialIdSet);
-	if (!TransitionMaterialCache.Contains(Code)) {
-		TTransitionMaterialCode tmp;
-		tmp.Code = Code;
-
-		UE_LOG(LogVt, Log, TEXT("create new transition terrain material instance -> id: %llu (%lu-%lu-%lu)"), Code, tmp.TriangleMatId[0], tmp.TriangleMatId[1], tmp.TriangleMatId[2]);
-		UMaterialInstanceDynamic* DynMaterial = UMaterialInstanceDynamic::Create(TransitionMaterial, this);
-
-		int Idx = 0;
-		for (unsigned short MatId : MaterialIdSet) {
-			if (MaterialMap.Contains(MatId)) {
-				FSandboxTerrainMaterial Mat = MaterialMap[MatId];
-				FName TextureDiffuseParam = FName(*FString::Printf(TEXT("TextureDiffuse%d"), Idx));
-				FName TextureNormalParam = FName(*FString::Printf(TEXT("TextureNormal%d"), Idx));
-				DynMaterial->SetTextureParameterValue(TextureDiffuseParam, Mat.TextureDiffuse);
-				DynMaterial->SetTextureParameterValue(TextureNormalParam, Mat.TextureNormal);
+	UMaterialInterface** MaterialPtr = TransitionMaterialCache.Find(Code);
+	if (MaterialPtr) {
+		return *MaterialPtr;
+	}
+
+	// mesh was not registered by worker or pending list is not processed yet
+	bMaterialCreatedOnLoad = true;
+	return CreateTransitionMaterial(Code, MaterialIdSet);
+}
+
+// game thread. instance of every regular material before any zone is loaded
+void ASandboxTerrainController::PrepareTerrainMaterials() {
+	if (GetNetMode() == NM_DedicatedServer || RegularMaterial == nullptr) {
+		return;
+	}
+
+	double Start = FPlatformTime::Seconds();
+
+	for (const auto& Elem : MaterialMap) {
+		if (!RegularMaterialCache.Contains(Elem.Key)) {
+			CreateRegularTerrainMaterial(Elem.Key);
+		}
+	}
+
+	double End = FPlatformTime::Seconds();
+	double Time = (End - Start) * 1000;
+	UE_LOG(LogVt, Log, TEXT("PrepareTerrainMaterials --> %d regular instances, %f ms"), RegularMaterialCache.Num(), Time);
+}
+
+// any thread. remember transition material sets of mesh, new ones get instance on next tick before zone apply
+void ASandboxTerrainController::RegisterTransitionMaterials(const TMeshData& MeshData) {
+	std::vector<std::pair<uint64, const std::set<unsigned short>*>> NewSetList;
+
+	{
+		const std::shared_lock<std::shared_timed_mutex> Lock(TransitionMaterialCodeMutex);
+
+		auto CollectNew = [&](const TMeshContainer& Container) {
+			for (const auto& Elem : Container.MaterialTransitionSectionMap) {
+				const uint64 Code = TMeshMaterialTransitionSection::GenerateTransitionCode(Elem.Value.MaterialIdSet);
+				if (TransitionMaterialCodeSet.find(Code) == TransitionMaterialCodeSet.end()) {
+					NewSetList.push_back({ Code, &Elem.Value.MaterialIdSet });
+				}
 			}
+		};
 
-			Idx++;
+		for (const auto& LodSection : MeshData.MeshSectionLodArray) {
+			CollectNew(LodSection.RegularMeshContainer);
+			for (const auto& Patch : LodSection.TransitionPatchArray) {
+				CollectNew(Patch);
+			}
 		}
+	}
+
+	if (NewSetList.empty()) {
+		return;
+	}
 
-		TransitionMaterialCache.Add(Code, DynMaterial);
-		return DynMaterial;
+	const std::unique_lock<std::shared_timed_mutex> Lock(TransitionMaterialCodeMutex);
+	for (const auto& NewSet : NewSetList) {
+		if (TransitionMaterialCodeSet.insert(NewSet.first).second) {
+			PendingTransitionMaterialList.push_back({ NewSet.first, *NewSet.second });
+		}
 	}
+}
+
+// game thread. called before conveyor, so zone apply finds instance ready. limited count per frame
+void ASandboxTerrainController::CreatePendingTransitionMaterials() {
+	std::vector<std::pair<uint64, std::set<unsigned short>>> PendingList;
+	const bool bCreate = GetNetMode() != NM_DedicatedServer && TransitionMaterial != nullptr;
 
-	return TransitionMaterialCache[Code];
-}
\ No newline at end of file
+	{
+		const std::unique_lock<std::shared_timed_mutex> Lock(TransitionMaterialCodeMutex);
+		if (PendingTransitionMaterialList.empty()) {
+			return;
+		}
+
+		// no instances at all: whole list is dropped
+		const size_t Num = bCreate ? std::min(PendingTransitionMaterialList.size(), (size_t)FMath::Max(TransitionMaterialsPerFrame, 1)) : PendingTransitionMaterialList.size();
+		PendingList.assign(std::make_move_iterator(PendingTransitionMaterialList.begin()), std::make_move_iterator(PendingTransitionMaterialList.begin() + Num));
+		PendingTransitionMaterialList.erase(PendingTransitionMaterialList.begin(), PendingTransitionMaterialList.begin() + Num);
+	}
+
+	if (!bCreate) {
+		return;
+	}
+
+	for (const auto& Pending : PendingList) {
+		if (!TransitionMaterialCache.Contains(Pending.first)) {
+			bMaterialCreatedOnLoad = true;
+			CreateTransitionMaterial(Pending.first, Pending.second);
+		}
+	}
+}
+
+// merged lod sections require texture array material
+bool ASandboxTerrainController::IsMergedLodSections() const {
+	return bMergeLodMaterialSections && MergedMaterial != nullptr;
+}
@@ -412,6 +412,64 @@ void ASandboxTerrainController::ForceSave(const TVoxelIndex& ZoneIndex, TVoxelDa
 	//SaveZoneToFile(TdFile, ZoneIndex, DataVd, DataMd, DataObj);
 }
 
+// lock zone and save mutex before call
+void ASandboxTerrainController::SaveZoneData(const TVoxelIndex& Index, TVoxelDataInfoPtr VdInfoPtr) {
+	TDataPtr DataVd = nullptr;
+	TDataPtr DataMd = nullptr;
+	TDataPtr DataObj = nullptr;
+
+	bool bSave = false;
+
+	if (VdInfoPtr->IsNeedTerrainSave()) {
+		if (VdInfoPtr->Vd && VdInfoPtr->CanSaveVd()) {
+			DataVd = SerializeVd(VdInfoPtr->Vd);
+		}
+
+		auto MeshDataPtr = VdInfoPtr->PopMeshDataCache();
+		if (MeshDataPtr) {
+			DataMd = SerializeMeshData(MeshDataPtr);
+		}
+		else {
+			if (VdInfoPtr->Vd && VdInfoPtr->Vd->getDensityFillState() == MIXED)
+				UE_LOG(LogVt, Error, TEXT("PopMeshDataCache fail -> %d %d %d"), Index.X, Index.Y, Index.Z);
+		}
+
+		if (FoliageDataAsset) {
+			UTerrainZoneComponent* Zone = VdInfoPtr->GetZone();
+			if (Zone) {
+				// IsNeedTerrainSave means zone was changed or generated therefore we not need to load mesh data 
+				DataObj = Zone->SerializeAndResetObjectData();
+			}
+		}
+
+		VdInfoPtr->ResetNeedTerrainSave();
+		VdInfoPtr->ResetNeedObjectsSave();
+		bSave = true;
+	}
+	else if (VdInfoPtr->IsNeedObjectsSave()) {
+		if (FoliageDataAsset) {
+			UTerrainZoneComponent* Zone = VdInfoPtr->GetZone();
+			if (Zone) {
+				DataObj = Zone->SerializeAndResetObjectData();
+				FKvdb::SaveData(DataFileId, TFileItmKey{ Index, TFileItmType::OBJ_DATA }, *DataObj, 0x00); // save objects only
+			}
+			// legacy
+			/*else {
+				auto InstanceObjectMapPtr = VdInfoPtr->GetOrCreateInstanceObjectMap();
+				if (InstanceObjectMapPtr) {
+					DataObj = UTerrainZoneComponent::SerializeInstancedMesh(*InstanceObjectMapPtr);
+				}
+			}*/
+		}
+
+		VdInfoPtr->ResetNeedObjectsSave();
+	}
+
+	if (bSave) {
+		uint32 CRC = SaveZoneToFile(VdInfoPtr, DataFileId, Index, DataVd, DataMd, DataObj);
+	}
+}
+
 void ASandboxTerrainController::Save(std::function<void(uint32, uint32)> OnProgress, std::function<void(uint32)> OnFinish) {
 	const std::lock_guard<std::mutex> lock(SaveMutex);
 
@@ -429,61 +487,8 @@ void ASandboxTerrainController::Save(std::function<void(uint32, uint32)> OnProgr
 	for (const TVoxelIndex& Index : SaveIndexSet) {
 		TVoxelDataInfoPtr VdInfoPtr = TerrainData->GetVoxelDataInfo(Index);
 
-		TDataPtr DataVd = nullptr;
-		TDataPtr DataMd = nullptr;
-		TDataPtr DataObj = nullptr;
-
 		VdInfoPtr->Lock();
-		bool bSave = false;
-
-		if (VdInfoPtr->IsNeedTerrainSave()) {
-			if (VdInfoPtr->Vd && VdInfoPtr->CanSaveVd()) {
-				DataVd = SerializeVd(VdInfoPtr->Vd);
-			}
-
-			auto MeshDataPtr = VdInfoPtr->PopMeshDataCache();
-			if (MeshDataPtr) {
-				DataMd = SerializeMeshData(MeshDataPtr);
-			}
-			else {
-				if (VdInfoPtr->Vd && VdInfoPtr->Vd->getDensityFillState() == MIXED)
-					UE_LOG(LogVt, Error, TEXT("PopMeshDataCache fail -> %d %d %d"), Index.X, Index.Y, Index.Z);
-			}
-
-			if (FoliageDataAsset) {
-				UTerrainZoneComponent* Zone = VdInfoPtr->GetZone();
-				if (Zone) {
-					// IsNeedTerrainSave means zone was changed or generated therefore we not need to load mesh data 
-					DataObj = Zone->SerializeAndResetObjectData();
-				}
-			}
-
-			VdInfoPtr->ResetNeedTerrainSave();
-			VdInfoPtr->ResetNeedObjectsSave();
-			bSave = true;
-		}
-		else if (VdInfoPtr->IsNeedObjectsSave()) {
-			if (FoliageDataAsset) {
-				UTerrainZoneComponent* Zone = VdInfoPtr->GetZone();
-				if (Zone) {
-					DataObj = Zone->SerializeAndResetObjectData();
-					FKvdb::SaveData(DataFileId, TFileItmKey{ Index, TFileItmType::OBJ_DATA }, *DataObj, 0x00); // save objects only
-				}
-				// legacy
-				/*else {
-					auto InstanceObjectMapPtr = VdInfoPtr->GetOrCreateInstanceObjectMap();
-					if (InstanceObjectMapPtr) {
-						DataObj = UTerrainZoneComponent::SerializeInstancedMesh(*InstanceObjectMapPtr);
-					}
-				}*/
-			}
-
-			VdInfoPtr->ResetNeedObjectsSave();
-		}
-
-		if (bSave) {
-			uint32 CRC = SaveZoneToFile(VdInfoPtr, DataFileId, Index, DataVd, DataMd, DataObj);
-		}
+		SaveZoneData(Index, VdInfoPtr);
 
 		SavedCount++;
 		VdInfoPtr->ResetLastSave();
@@ -2,6 +2,9 @@
 
 #include "EngineMinimal.h"
 #include "VoxelIndex.h"
+#include <vector>
+#include <algorithm>
+#include <mutex>
 
 //======================================================================================================================================================================
 //
@@ -20,6 +23,15 @@ struct TTerrainAreaLoadParams {
 	int32 TerrainSizeMinZ = -5;
 	int32 TerrainSizeMaxZ = 5;
 
+	// predictive streaming. zero lookahead - symmetric spiral, view direction only orders chunks of moving player
+	FVector2D Lookahead = FVector2D::ZeroVector;
+	FVector2D ViewDirection = FVector2D::ZeroVector;
+	float BehindRadiusRatio = 1.f;
+
+	// skip zones without geometry: far from surface, not saved and without structures
+	bool bFollowSurface = false;
+	int32 SurfaceMargin = 1;
+
 	std::function<void(uint32, uint32)> OnProgress = nullptr;
 };
 
@@ -49,7 +61,7 @@ protected:
 	TVoxelIndex OriginIndex;
 	uint32 Total = 0;
 	uint32 Progress = 0;
-	bool bIsStopped = false;
+	std::atomic<bool> bIsStopped { false };
 
 protected:
 
@@ -67,11 +79,42 @@ protected:
 
 private:
 
+	// zones of column which can have geometry itself or in margin
+	void ClcSurfaceColumn(int X, int Y, std::vector<bool>& Column) {
+		const int32 Margin = FMath::Max(Params.SurfaceMargin, 0);
+		const int32 MinZ = Params.TerrainSizeMinZ - Margin;
+		const int32 MaxZ = Params.TerrainSizeMaxZ + Margin;
+
+		std::vector<bool> HasGeometry(MaxZ - MinZ + 1, false);
+		for (int Z = MinZ; Z <= MaxZ; Z++) {
+			const TVoxelIndex Index(X + OriginIndex.X, Y + OriginIndex.Y, Z + OriginIndex.Z);
+			HasGeometry[Z - MinZ] = Controller->CheckZoneCanHaveGeometry(Index);
+		}
+
+		Column.assign(Params.TerrainSizeMaxZ - Params.TerrainSizeMinZ + 1, false);
+		for (int Z = Params.TerrainSizeMinZ; Z <= Params.TerrainSizeMaxZ; Z++) {
+			for (int M = -Margin; M <= Margin; M++) {
+				if (HasGeometry[Z + M - MinZ]) {
+					Column[Z - Params.TerrainSizeMinZ] = true;
+					break;
+				}
+			}
+		}
+	}
+
 	void PerformChunk(int X, int Y) {
+		std::vector<bool> SurfaceColumn;
+		if (Params.bFollowSurface) {
+			ClcSurfaceColumn(X, Y, SurfaceColumn);
+		}
+
 		for (int Z = Params.TerrainSizeMinZ; Z <= Params.TerrainSizeMaxZ; Z++) {
 			TVoxelIndex Index(X + OriginIndex.X, Y + OriginIndex.Y, Z + OriginIndex.Z);
 
-			PerformZone(Index);
+			if (!Params.bFollowSurface || SurfaceColumn[Z - Params.TerrainSizeMinZ]) {
+				PerformZone(Index);
+			}
+
 			Progress++;
 
 			if (Params.OnProgress) {
@@ -84,10 +127,49 @@ private:
 		}
 	}
 
+	// chunks ahead of motion first, area stretched by lookahead and shrunk behind
+	std::list<TChunkIndex> DirectionalWalkthrough(const unsigned int AreaRadius) {
+		const float R = (float)AreaRadius;
+		// frontier stays inside of unload radius (1.5 of area radius), otherwise it is loaded and unloaded on every check
+		const float L = FMath::Min(Params.Lookahead.Size() / USBT_ZONE_SIZE, R * 0.25f);
+		const FVector2D MoveDir = Params.Lookahead.GetSafeNormal();
+		const FVector2D PrioDir = MoveDir.IsZero() ? Params.ViewDirection.GetSafeNormal() : MoveDir;
+		const int MaxR = (int)FMath::CeilToFloat(R + L);
+
+		std::vector<std::pair<float, TChunkIndex>> Tmp;
+		Tmp.reserve((MaxR * 2 + 1) * (MaxR * 2 + 1));
+
+		for (int X = -MaxR; X <= MaxR; X++) {
+			for (int Y = -MaxR; Y <= MaxR; Y++) {
+				const FVector2D P((float)X, (float)Y);
+				const float D = P.Size();
+				const float Cos = (D > 0) ? FVector2D::DotProduct(P, MoveDir) / D : 0;
+				const float Limit = (Cos >= 0) ? R + L * Cos : R * (1.f + (Params.BehindRadiusRatio - 1.f) * -Cos);
+				if (D > Limit && D > 1.5f) {
+					continue;
+				}
+
+				const float Key = D - 0.5f * FVector2D::DotProduct(P, PrioDir);
+				Tmp.push_back({ Key, TChunkIndex(X, Y) });
+			}
+		}
+
+		std::stable_sort(Tmp.begin(), Tmp.end(), [](const auto& A, const auto& B) { return A.first < B.first; });
+
+		std::list<TChunkIndex> List;
+		for (const auto& Itm : Tmp) {
+			List.push_back(Itm.second);
+		}
+
+		return List;
+	}
+
 	void AreaWalkthrough() {
 		const unsigned int AreaRadius = Params.Radius / 1000;
-		Total = (AreaRadius * 2 + 1) * (AreaRadius * 2 + 1) * (Params.TerrainSizeMinZ + Params.TerrainSizeMaxZ + 1);
-		auto List = ReverseSpiralWalkthrough(AreaRadius);
+		// stationary player keeps whole square area, directional area is a circle
+		const bool bDirectional = !Params.Lookahead.IsZero();
+		auto List = bDirectional ? DirectionalWalkthrough(AreaRadius) : ReverseSpiralWalkthrough(AreaRadius);
+		Total = (uint32)List.size() * (Params.TerrainSizeMinZ + Params.TerrainSizeMaxZ + 1);
 		int Idx = 1;
 		for (auto& Itm : List) {
 			int RelX = Itm.X;
@@ -167,4 +249,25 @@ class TCheckAreaMap {
 public:
 	TMap<uint32, std::shared_ptr<TTerrainLoadHelper>> PlayerStreamingHandler;
 	TMap<uint32, FVector> PlayerStreamingPosition;
+	TMap<uint32, FVector2D> PlayerStreamingDirection;
+
+	// player locations for conveyor task priority. any thread
+	void SetFocus(const TArray<FVector>& LocationList) {
+		const std::lock_guard<std::mutex> Lock(FocusMutex);
+		FocusList = LocationList;
+	}
+
+	// squared distance to nearest player, zero if unknown
+	float ClcFocusDistSquared(const FVector& Pos) {
+		const std::lock_guard<std::mutex> Lock(FocusMutex);
+		float Res = (FocusList.Num() > 0) ? FLT_MAX : 0;
+		for (const FVector& Location : FocusList) {
+			Res = FMath::Min(Res, (float)FVector::DistSquared(Pos, Location));
+		}
+		return Res;
+	}
+
+private:
+	std::mutex FocusMutex;
+	TArray<FVector> FocusList;
 };
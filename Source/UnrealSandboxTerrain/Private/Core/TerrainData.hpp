@@ -26,12 +26,29 @@ struct TSyncItem {
 };
 
 class TTerrainData {
+
+public:
+
+	// zone registry split in shards, each with own lock. lookup takes shared lock only
+	static constexpr int StorageShardNum = 32;
+
+	// high bits, low bits select buckets inside shard map
+	static int ClcStorageShardIndex(const TVoxelIndex& Index) {
+		return (int)((ClcVoxelIndexHash(Index.X, Index.Y, Index.Z) >> 48) % StorageShardNum);
+	}
     
 private:
 
+	struct TStorageShard {
+		std::shared_timed_mutex Mutex;
+		std::unordered_map<TVoxelIndex, TVoxelDataInfoPtr> Map;
+	};
 
-	std::shared_timed_mutex StorageMapMutex;
-	std::unordered_map<TVoxelIndex, std::shared_ptr<TVoxelDataInfo>> StorageMap;
+	TStorageShard StorageShardArray[StorageShardNum];
+
+	TStorageShard& GetStorageShard(const TVoxelIndex& Index) {
+		return StorageShardArray[ClcStorageShardIndex(Index)];
+	}
 
 	std::shared_timed_mutex SaveIndexSetMutex;
 	std::unordered_set<TVoxelIndex> SaveIndexSet;
@@ -44,9 +61,41 @@ private:
 	std::mutex ModifiedVdMapMutex;
 
 	std::atomic<int32> ZonesCount = 0;
+
+	// live zones bucketed by XY cell
+	std::shared_timed_mutex ZoneGridMutex;
+	std::unordered_map<TVoxelIndex, std::unordered_set<TVoxelIndex>> ZoneGrid;
+
+	static int FloorDiv(const int A, const int B) {
+		return (A >= 0) ? A / B : (A - B + 1) / B;
+	}
     
 public:
 
+	// zones per cell side
+	static constexpr int ZoneGridCellSize = 8;
+
+	static TVoxelIndex ClcZoneGridCell(const TVoxelIndex& ZoneIndex) {
+		return TVoxelIndex(FloorDiv(ZoneIndex.X, ZoneGridCellSize), FloorDiv(ZoneIndex.Y, ZoneGridCellSize), 0);
+	}
+
+	// Fn(const TVoxelIndex& Cell, const std::unordered_set<TVoxelIndex>& ZoneSet)
+	// do not add or remove zones inside Fn
+	template<typename Function>
+	void ForEachZoneGridCell(Function Fn) {
+		std::shared_lock<std::shared_timed_mutex> Lock(ZoneGridMutex);
+		for (const auto& P : ZoneGrid) {
+			Fn(P.first, P.second);
+		}
+	}
+
+	// copy of zone set of one cell
+	std::unordered_set<TVoxelIndex> GetZoneGridCell(const TVoxelIndex& Cell) {
+		std::shared_lock<std::shared_timed_mutex> Lock(ZoneGridMutex);
+		auto It = ZoneGrid.find(Cell);
+		return (It != ZoneGrid.end()) ? It->second : std::unordered_set<TVoxelIndex>();
+	}
+
 	int32 GetMapVStamp() {
 		return MapVerHash;
 	}
@@ -171,10 +220,16 @@ public:
     void AddZone(const TVoxelIndex& Index, UTerrainZoneComponent* ZoneComponent){
 		GetVoxelDataInfo(Index)->AddZone(ZoneComponent);
 		ZonesCount++;
+
+		if (ZoneComponent) {
+			std::unique_lock<std::shared_timed_mutex> Lock(ZoneGridMutex);
+			ZoneGrid[ClcZoneGridCell(Index)].insert(Index);
+		}
     }
     
     UTerrainZoneComponent* GetZone(const TVoxelIndex& Index){
-        return GetVoxelDataInfo(Index)->GetZone();
+		TVoxelDataInfoPtr VdInfoPtr = FindVoxelDataInfo(Index);
+		return VdInfoPtr ? VdInfoPtr->GetZone() : nullptr;
     }
 
 	void RemoveZone(const TVoxelIndex& Index) {
@@ -182,21 +237,62 @@ public:
 		Ptr->ResetSpawnFinished();
 		Ptr->RemoveZone();
 		ZonesCount--;
+
+		std::unique_lock<std::shared_timed_mutex> Lock(ZoneGridMutex);
+		auto It = ZoneGrid.find(ClcZoneGridCell(Index));
+		if (It != ZoneGrid.end()) {
+			It->second.erase(Index);
+			if (It->second.empty()) {
+				ZoneGrid.erase(It);
+			}
+		}
 	}
     
 	//=====================================================================================
 	// terrain voxel data 
 	//=====================================================================================
     
+	// nullptr if not exist
+	TVoxelDataInfoPtr FindVoxelDataInfo(const TVoxelIndex& Index) {
+		TStorageShard& Shard = GetStorageShard(Index);
+		std::shared_lock<std::shared_timed_mutex> Lock(Shard.Mutex);
+		auto It = Shard.Map.find(Index);
+		if (It != Shard.Map.end()) {
+			return It->second;
+		}
+
+		return nullptr;
+	}
+
+	// Fn(const TVoxelIndex& Index, const TVoxelDataInfoPtr& VdInfoPtr). do not create entries inside Fn
+	template<typename Function>
+	void ForEachVoxelDataInfo(Function Fn) {
+		for (auto& Shard : StorageShardArray) {
+			std::shared_lock<std::shared_timed_mutex> Lock(Shard.Mutex);
+			for (const auto& P : Shard.Map) {
+				Fn(P.first, P.second);
+			}
+		}
+	}
+
+	// create if not exist
 	TVoxelDataInfoPtr GetVoxelDataInfo(const TVoxelIndex& Index) {
-		std::unique_lock<std::shared_timed_mutex> Lock(StorageMapMutex);
-		if (StorageMap.find(Index) != StorageMap.end()) {
-			return StorageMap[Index];
-		} else {
-			TVoxelDataInfoPtr NewVdinfo = std::make_shared<TVoxelDataInfo>();
-			StorageMap.insert({ Index, NewVdinfo });
-			return NewVdinfo;
+		TVoxelDataInfoPtr VdInfoPtr = FindVoxelDataInfo(Index);
+		if (VdInfoPtr) {
+			return VdInfoPtr;
 		}
+
+		TStorageShard& Shard = GetStorageShard(Index);
+		std::unique_lock<std::shared_timed_mutex> Lock(Shard.Mutex);
+		auto It = Shard.Map.find(Index);
+		if (It != Shard.Map.end()) {
+			return It->second;
+		}
+
+		TVoxelDataInfoPtr NewVdinfo = std::make_shared<TVoxelDataInfo>();
+		NewVdinfo->Touch();
+		Shard.Map.insert({ Index, NewVdinfo });
+		return NewVdinfo;
     }
 
 	//=====================================================================================
@@ -205,8 +301,12 @@ public:
 
     void Clean(){
 		// no locking because end play only
-		StorageMap.clear();
+		for (auto& Shard : StorageShardArray) {
+			Shard.Map.clear();
+		}
+
 		ModifiedVdMap.Empty();
+		ZoneGrid.clear();
     }
 };
 
@@ -3,41 +3,100 @@
 #include <atomic>
 #include <vector>
 #include <list>
+#include <map>
+#include <unordered_map>
+#include <cstdint>
 #include <mutex>
 #include <functional>
 #include <thread>
 
+// game thread tasks by class (lower first), each class ordered by priority (lower first), FIFO on equal priority.
+// class waiting for max_wait pops of other classes goes first, so steady stream of lower classes can't starve it
 class TConveyour {
 
+public:
+
+    static constexpr int class_num = 4;
+
+    static constexpr int max_wait = 32;
+
 private:
     std::mutex m;
 
-    std::list<std::function<void()>> list;
+    std::multimap<float, std::function<void()>> queue[class_num];
 
     std::atomic<int> s{0};
 
+    // pops of other classes while class is not empty
+    int wait[class_num] = { 0 };
+
+    int select_class() const {
+        int first = -1;
+        for (int cls = 0; cls < class_num; cls++) {
+            if (queue[cls].size() > 0) {
+                if (wait[cls] >= max_wait) {
+                    return cls;
+                }
+
+                if (first < 0) {
+                    first = cls;
+                }
+            }
+        }
+
+        return first;
+    }
+
+    // moving average of task time per class. game thread only
+    double cost[class_num] = { 0 };
+
 public:
 
-    void push(std::function<void()> f) {
+    void push(std::function<void()> f, int cls = class_num - 1, float prio = 0) {
         const std::lock_guard<std::mutex> lock(m);
-        list.push_back(f);
+        queue[cls].emplace(prio, f);
         s++;
     }
 
     bool pop(std::function<void()>& f) {
+        int cls;
+        return pop(f, cls);
+    }
+
+    bool pop(std::function<void()>& f, int& cls) {
         const std::lock_guard<std::mutex> lock(m);
 
-        if (list.size() == 0) {
+        cls = select_class();
+        if (cls < 0) {
             return false;
         }
 
-        f = list.front();
-        list.pop_front();
+        auto& q = queue[cls];
+        auto it = q.begin();
+        f = it->second;
+        q.erase(it);
         s--;
 
+        for (int other = 0; other < class_num; other++) {
+            wait[other] = (other == cls || queue[other].size() == 0) ? 0 : wait[other] + 1;
+        }
+
         return true;
     }
 
+    int front_class() {
+        const std::lock_guard<std::mutex> lock(m);
+        return select_class();
+    }
+
+    void track_cost(int cls, double t) {
+        cost[cls] = (cost[cls] == 0) ? t : cost[cls] * 0.9 + t * 0.1;
+    }
+
+    double estimate_cost(int cls) const {
+        return cost[cls];
+    }
+
     int size() {
         return s.load();
     }
@@ -59,7 +118,15 @@ private:
 
     std::vector<std::thread> thread_list;
 
-    std::list<std::function<void()>> task_list;
+    struct TPoolTask {
+        std::function<void()> f;
+        uint64_t key = 0;
+    };
+
+    std::list<TPoolTask> task_list;
+
+    // queued (not started) tasks with key
+    std::unordered_map<uint64_t, std::list<TPoolTask>::iterator> key_map;
 
     void run() {
         while (!shutdown.test()) {
@@ -67,7 +134,10 @@ private:
             cv.wait(lock, [this]()->bool { return task_list.size() > 0 || shutdown.test(); });
 
             if (task_list.size() > 0 && !shutdown.test()) {
-                std::function<void()> f = task_list.front();
+                std::function<void()> f = std::move(task_list.front().f);
+                if (task_list.front().key != 0) {
+                    key_map.erase(task_list.front().key);
+                }
                 task_list.pop_front();
                 task_size--;
                 lock.unlock();
@@ -94,14 +164,30 @@ public:
         shutdownAndWait();
     };
 
-    void addTask(const std::function<void()> task, bool bHiPrio = false) {
+    // key != 0: task replaces queued task with same key and keeps its place in queue. started task is not affected
+    void addTask(const std::function<void()> task, bool bHiPrio = false, uint64_t key = 0) {
         std::lock_guard<std::mutex> lock(mutex);
+
+        if (key != 0) {
+            auto it = key_map.find(key);
+            if (it != key_map.end()) {
+                it->second->f = task;
+                return;
+            }
+        }
+
         task_size++;
 
         if (bHiPrio) {
-            task_list.push_front(task);
+            task_list.push_front(TPoolTask{ task, key });
+            if (key != 0) {
+                key_map[key] = task_list.begin();
+            }
         } else {
-            task_list.push_back(task);
+            task_list.push_back(TPoolTask{ task, key });
+            if (key != 0) {
+                key_map[key] = std::prev(task_list.end());
+            }
         }
 
         cv.notify_one();
@@ -118,6 +204,8 @@ public:
         }
 
         thread_list.clear();
+        task_list.clear();
+        key_map.clear();
         task_size = 0;
     }
 
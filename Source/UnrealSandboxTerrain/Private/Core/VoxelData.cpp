@@ -266,6 +266,27 @@ int TVoxelData::num() const {
 	return voxel_num;
 }
 
+size_t TVoxelData::getMemorySize() const {
+	const size_t n = (size_t)voxel_num * voxel_num * voxel_num;
+	size_t s = sizeof(TVoxelData);
+
+	if (density_data != NULL) {
+		s += n * sizeof(TDensityVal);
+	}
+
+	if (material_data != NULL) {
+		s += n * sizeof(TMaterialId);
+	}
+
+	s += normal_data.capacity() * sizeof(FVector);
+
+	for (const auto& cache : substanceCacheLOD) {
+		s += cache.size() * sizeof(TSubstanceCacheItem);
+	}
+
+	return s;
+}
+
 void TVoxelData::deinitializeDensity(TVoxelDataFillState State) {
 	if (State == TVoxelDataFillState::MIXED) {
 		return;
@@ -317,7 +338,7 @@ bool TVoxelData::performCellSubstanceCaching(int x, int y, int z, int lod, int s
 	}
 }
 
-FORCEINLINE void TVoxelData::performSubstanceCacheNoLOD(int x, int y, int z) {
+void TVoxelData::performSubstanceCacheNoLOD(int x, int y, int z) {
 	if (density_data == NULL) {
 		return;
 	}
@@ -340,39 +361,6 @@ void TVoxelData::performSubstanceCacheLOD(int x, int y, int z, int initial_lod)
 	}
 }
 
-void TVoxelData::forEach(std::function<void(int x, int y, int z)> func) {
-	for (int x = 0; x < num(); x++)
-		for (int y = 0; y < num(); y++)
-			for (int z = 0; z < num(); z++)
-				func(x, y, z);
-}
-
-void TVoxelData::forEachWithCache(std::function<void(int x, int y, int z)> func, bool LOD) {
-	clearSubstanceCache();
-	initCache();
-
-	for (int x = 0; x < num(); x++) {
-		for (int y = 0; y < num(); y++) {
-			for (int z = 0; z < num(); z++) {
-				func(x, y, z);
-
-				if (LOD) {
-					performSubstanceCacheLOD(x, y, z);
-				} else {
-					performSubstanceCacheNoLOD(x, y, z);
-				}
-
-			}
-		}
-	}
-}
-
-void TVoxelData::forEachCacheItem(const int lod, std::function<void(const TSubstanceCacheItem& itm)> func) const{
-	substanceCacheLOD[lod].forEach([=](const TSubstanceCacheItem& itm) {
-		func(itm);
-	});
-}
-
 FORCEINLINE int TVoxelData::clcLinearIndex(int x, int y, int z) const {
 	//return x * voxel_num * voxel_num + y * voxel_num + z;
 	return vd::tools::clcLinearIndex(voxel_num, x, y, z);
@@ -513,13 +501,6 @@ void TSubstanceCache::clear() {
 	idx = 0;
 }
 
-void TSubstanceCache::forEach(std::function<void(const TSubstanceCacheItem& itm)> func) const {
-	//for (const auto& itm : cellList) {
-	for (int i = 0; i < idx; i++) {
-		func(cellArray[i]);
-	}
-}
-
 void TSubstanceCache::copy(const int* cache_data, const int len) {
 	cellArray.resize(len);
 	memcpy(cellArray.data(), cache_data, len * sizeof(TSubstanceCacheItem));
@@ -32,6 +32,10 @@ public:
     void unlock() {
         atomic_flag.clear(std::memory_order_release);
     }
+
+    bool try_lock() {
+        return !atomic_flag.test_and_set(std::memory_order_acquire);
+    }
 };
 
 class TVoxelDataInfo {
@@ -42,6 +46,12 @@ private:
     volatile double LastMeshGeneration;
     volatile double LastCacheCheck;
 
+    // last voxel or mesh data use. registry lookup is not an access
+    std::atomic<double> LastAccess { 0 };
+
+    // last calculated memory size. used when zone is busy
+    std::atomic<size_t> LastMemorySize { 0 };
+
 #ifdef __cpp_lib_atomic_shared_ptr                      
     std::atomic<TMeshDataPtr> MeshDataCachePtr = nullptr;
 #else
@@ -91,6 +101,46 @@ public:
         VdMutex.unlock();
     }
 
+    bool TryLock() {
+        return VdMutex.try_lock();
+    }
+
+    void Touch() {
+        LastAccess = FPlatformTime::Seconds();
+    }
+
+    double GetLastAccess() const {
+        return LastAccess;
+    }
+
+    // approximate memory of voxel data, mesh cache and instance objects. lock before call
+    size_t ClcMemorySize() {
+        size_t Size = sizeof(TVoxelDataInfo);
+
+        if (Vd) {
+            Size += Vd->getMemorySize();
+        }
+
+        TMeshDataPtr MeshDataPtr = GetMeshDataCache();
+        if (MeshDataPtr) {
+            Size += MeshDataPtr->GetAllocatedSize();
+        }
+
+        std::shared_lock<std::shared_timed_mutex> Lock(InstanceObjectMapMutex);
+        if (InstanceMeshTypeMapPtr) {
+            for (const auto& Elem : *InstanceMeshTypeMapPtr) {
+                Size += Elem.Value.TransformArray.GetAllocatedSize();
+            }
+        }
+
+        LastMemorySize = Size;
+        return Size;
+    }
+
+    size_t GetLastMemorySize() const {
+        return LastMemorySize;
+    }
+
     int GetFlagInternal() {
         return FlagInternal;
     }
@@ -149,6 +199,7 @@ public:
     
     void SetChanged() {
         LastChange = FPlatformTime::Seconds();
+        Touch();
     }
     
     bool IsChanged() {
@@ -158,6 +209,10 @@ public:
     void ResetLastSave() {
         LastSave = FPlatformTime::Seconds();
     }
+
+    bool IsSaved() const {
+        return LastSave > 0;
+    }
     
     bool IsNeedToRegenerateMesh() {
         return LastChange > LastMeshGeneration;
@@ -197,6 +252,7 @@ public:
     }
 
 	void PushMeshDataCache(TMeshDataPtr MeshDataPtr) {
+        Touch();
 #ifdef __cpp_lib_atomic_shared_ptr                      
         MeshDataCachePtr.store(MeshDataPtr);
 #else
@@ -7,7 +7,11 @@
 * 
 */
 
+#pragma once
+
 #include "VoxelMeshComponent.h"
+#include "FarTerrainComponent.h"
+#include "TerrainBatchComponent.h"
 #include "SandboxTerrainController.h"
 #include "Engine.h"
 #include "DynamicMeshBuilder.h"
@@ -102,29 +106,51 @@ public:
 
 extern float LodScreenSizeArray[LOD_ARRAY_SIZE];
 
-static void ConvertProcMeshToDynMeshVertex(FDynamicMeshVertex& Vert, const TMeshVertex& ProcVert) {
-	Vert.Position.X = ProcVert.Pos.X;
-	Vert.Position.Y = ProcVert.Pos.Y;
-	Vert.Position.Z = ProcVert.Pos.Z;
-
-	switch (ProcVert.MatIdx) {
-	case 0:  Vert.Color = FColor(255, 0, 0, 0); break;
-	case 1:  Vert.Color = FColor(0, 255, 0, 0); break;
-	case 2:  Vert.Color = FColor(0, 0, 255, 0); break;
-	default: Vert.Color = FColor(0, 0, 0, 0); break;
+/**
+* terrain vertex in packed layout of local vertex factory streams:
+* float3 position | 2 x packed normal (tangent basis) | half2 uv (material ids of merged section) | color (transition material weight)
+* render section is prepared by worker and kept with mesh data, here it is only copied as whole buffers
+*/
+static void InitPackedVertexBuffers(FStaticMeshVertexBuffers& VertexBuffers, const TMeshRenderSection& RenderSection) {
+	const int32 NumVerts = RenderSection.NumVertices();
+
+	VertexBuffers.PositionVertexBuffer.Init(NumVerts, false);
+	VertexBuffers.StaticMeshVertexBuffer.SetUseHighPrecisionTangentBasis(false);
+	VertexBuffers.StaticMeshVertexBuffer.SetUseFullPrecisionUVs(false);
+	VertexBuffers.StaticMeshVertexBuffer.Init(NumVerts, RenderSection.NumTexCoords(), false);
+	VertexBuffers.ColorVertexBuffer.Init(NumVerts, false);
+
+	FMemory::Memcpy(VertexBuffers.PositionVertexBuffer.GetVertexData(), RenderSection.Positions.GetData(), RenderSection.Positions.Num() * RenderSection.Positions.GetTypeSize());
+	FMemory::Memcpy(VertexBuffers.StaticMeshVertexBuffer.GetTangentData(), RenderSection.Tangents.GetData(), RenderSection.Tangents.Num() * RenderSection.Tangents.GetTypeSize());
+	if (RenderSection.TexCoords.Num() > 0) {
+		FMemory::Memcpy(VertexBuffers.StaticMeshVertexBuffer.GetTexCoordData(), RenderSection.TexCoords.GetData(), RenderSection.TexCoords.Num() * RenderSection.TexCoords.GetTypeSize());
+	} else {
+		FMemory::Memzero(VertexBuffers.StaticMeshVertexBuffer.GetTexCoordData(), VertexBuffers.StaticMeshVertexBuffer.GetTexCoordSize()); // ignore texture crd
 	}
+	FMemory::Memcpy(VertexBuffers.ColorVertexBuffer.GetVertexData(), RenderSection.Colors.GetData(), RenderSection.Colors.Num() * RenderSection.Colors.GetTypeSize());
+}
 
-	// ignore texture crd
-#if ENGINE_MAJOR_VERSION == 5
-	Vert.TextureCoordinate[0] = FVector2f(0.f, 0.f);
+// bind packed buffers to local vertex factory. render commands are executed in order, so buffers are initialized before bind
+static void BeginInitPackedVertexFactory(FStaticMeshVertexBuffers* VertexBuffers, FLocalVertexFactory* VertexFactory) {
+	BeginInitResource(&VertexBuffers->PositionVertexBuffer);
+	BeginInitResource(&VertexBuffers->StaticMeshVertexBuffer);
+	BeginInitResource(&VertexBuffers->ColorVertexBuffer);
+
+	ENQUEUE_RENDER_COMMAND(InitTerrainPackedVertexFactory)([VertexBuffers, VertexFactory](FRHICommandListImmediate& RHICmdList) {
+		FLocalVertexFactory::FDataType Data;
+		VertexBuffers->PositionVertexBuffer.BindPositionVertexBuffer(VertexFactory, Data);
+		VertexBuffers->StaticMeshVertexBuffer.BindTangentVertexBuffer(VertexFactory, Data);
+		VertexBuffers->StaticMeshVertexBuffer.BindPackedTexCoordVertexBuffer(VertexFactory, Data);
+		VertexBuffers->StaticMeshVertexBuffer.BindLightMapVertexBuffer(VertexFactory, Data, 0);
+		VertexBuffers->ColorVertexBuffer.BindColorVertexBuffer(VertexFactory, Data);
+#if ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 3
+		VertexFactory->SetData(RHICmdList, Data);
 #else
-	Vert.TextureCoordinate[0] = FVector2D(0.f, 0.f);
+		VertexFactory->SetData(Data);
 #endif
+	});
 
-	// ignore tangent
-	Vert.TangentX = FVector(1.f, 0.f, 0.f);
-	Vert.TangentZ = ProcVert.Normal;
-	Vert.TangentZ.Vector.W = 0;
+	BeginInitResource(VertexFactory);
 }
 
 // ================================================================================================================================================
@@ -139,7 +165,7 @@ protected:
 
 public:
 
-	FAbstractMeshSceneProxy(UVoxelMeshComponent* Component) : FPrimitiveSceneProxy(Component), 
+	FAbstractMeshSceneProxy(UMeshComponent* Component) : FPrimitiveSceneProxy(Component), 
 		MaterialRelevance(Component->GetMaterialRelevance(GetScene().GetFeatureLevel())) { }
 
 	SIZE_T GetTypeHash() const override {
@@ -159,35 +185,18 @@ public:
 		return(FPrimitiveSceneProxy::GetAllocatedSize());
 	}
 
-	FORCEINLINE void CopySection(FProcMeshSection& SrcSection, FProcMeshProxySection* NewSection) {
-		if (SrcSection.ProcIndexBuffer.Num() > 0 && SrcSection.ProcVertexBuffer.Num() > 0) {
+	FORCEINLINE void CopySection(const TMeshRenderSectionPtr& SrcSection, FProcMeshProxySection* NewSection) {
+		if (SrcSection && SrcSection->Indices.Num() > 0 && SrcSection->NumVertices() > 0) {
 
-			// Copy data from vertex buffer
-			const int32 NumVerts = SrcSection.ProcVertexBuffer.Num();
-
-			// Allocate verts
-			TArray<FDynamicMeshVertex> Vertices;
-			Vertices.SetNumUninitialized(NumVerts);
-			// Copy verts
-			for (int VertIdx = 0; VertIdx < NumVerts; VertIdx++) {
-				const TMeshVertex& ProcVert = SrcSection.ProcVertexBuffer[VertIdx];
-				FDynamicMeshVertex& Vert = Vertices[VertIdx];
-				ConvertProcMeshToDynMeshVertex(Vert, ProcVert);
-			}
+			// Copy verts to packed render buffers
+			InitPackedVertexBuffers(NewSection->VertexBuffers, *SrcSection);
 
 			// Copy index buffer
-			NewSection->IndexBuffer.Indices = SrcSection.ProcIndexBuffer;
-
-			// Init vertex factory
-			//NewSection->VertexFactory.Init(&NewSection->VertexBuffer);
-			NewSection->VertexBuffers.InitFromDynamicVertex(&NewSection->VertexFactory, Vertices);
+			NewSection->IndexBuffer.Indices = SrcSection->Indices;
 
 			// Enqueue initialization of render resource
-			BeginInitResource(&NewSection->VertexBuffers.PositionVertexBuffer);
-			BeginInitResource(&NewSection->VertexBuffers.StaticMeshVertexBuffer);
-			BeginInitResource(&NewSection->VertexBuffers.ColorVertexBuffer);
 			BeginInitResource(&NewSection->IndexBuffer);
-			BeginInitResource(&NewSection->VertexFactory);
+			BeginInitPackedVertexFactory(&NewSection->VertexBuffers, &NewSection->VertexFactory);
 
 			// Grab material
 			if (NewSection->Material == nullptr) {
@@ -203,7 +212,8 @@ public:
 	// Draw static mesh
 	//================================================================================================
 
-	void DrawStaticMeshSection(FStaticPrimitiveDrawInterface* PDI, FProcMeshProxySection* Section, int LODIndex) {
+	// ScreenSize < 0: by lod index
+	void DrawStaticMeshSection(FStaticPrimitiveDrawInterface* PDI, FProcMeshProxySection* Section, int LODIndex, float ScreenSize = -1.f) {
 		FMaterialRenderProxy* MaterialInstance = Section->Material->GetRenderProxy();
 
 		FMeshBatch Mesh;
@@ -224,7 +234,10 @@ public:
 		BatchElement.MinVertexIndex = 0;
 		BatchElement.MaxVertexIndex = Section->VertexBuffers.PositionVertexBuffer.GetNumVertices() - 1;
 
-		const float ScreenSize = LodScreenSizeArray[LODIndex];
+		if (ScreenSize < 0) {
+			ScreenSize = LodScreenSizeArray[LODIndex];
+		}
+
 		//PDI->DrawMesh(Mesh, MAX_FLT); // no LOD
 		PDI->DrawMesh(Mesh, ScreenSize);
 	}
@@ -234,7 +247,12 @@ public:
 	//================================================================================================
 
 	FORCEINLINE void DrawDynamicMeshSection(const FProcMeshProxySection* Section, FMeshElementCollector& Collector, FMaterialRenderProxy* MaterialProxy, bool bWireframe, int32 ViewIndex) const {
-		if (Section->VertexBuffers.PositionVertexBuffer.GetNumVertices() == 0) return;
+		DrawDynamicMeshSection(Section, Collector, MaterialProxy, bWireframe, ViewIndex, 0, Section->IndexBuffer.Indices.Num() / 3);
+	}
+
+	// draw part of index buffer
+	FORCEINLINE void DrawDynamicMeshSection(const FProcMeshProxySection* Section, FMeshElementCollector& Collector, FMaterialRenderProxy* MaterialProxy, bool bWireframe, int32 ViewIndex, uint32 FirstIndex, uint32 NumPrimitives) const {
+		if (Section->VertexBuffers.PositionVertexBuffer.GetNumVertices() == 0 || NumPrimitives == 0) return;
 
 		// Draw the mesh.
 		FMeshBatch& Mesh = Collector.AllocateMesh();
@@ -260,8 +278,8 @@ public:
 
 		BatchElement.PrimitiveUniformBufferResource = &DynamicPrimitiveUniformBuffer.UniformBuffer;
 
-		BatchElement.FirstIndex = 0;
-		BatchElement.NumPrimitives = Section->IndexBuffer.Indices.Num() / 3;
+		BatchElement.FirstIndex = FirstIndex;
+		BatchElement.NumPrimitives = NumPrimitives;
 		BatchElement.MinVertexIndex = 0;
 		BatchElement.MaxVertexIndex = Section->VertexBuffers.PositionVertexBuffer.GetNumVertices() - 1;
 		Mesh.ReverseCulling = IsLocalToWorldDeterminantNegative();
@@ -305,6 +323,23 @@ private:
 
 	FVector ZoneOrigin;
 	float CullDistance = 20000.f;
+	float CullDepth = 10000.f;
+
+	// world box of zone mesh, tighter than zone bounds
+	FBox MeshBox;
+
+	// zone is not reachable from view through not solid zones. set by controller
+	bool bOccluded = false;
+
+	// drawn by zone batch. set by controller
+	bool bBatched = false;
+
+	// lod state selected by controller, updated by render command. -1: lod by screen size and patches per frame
+	int32 FixedLodIndex = -1;
+	uint8 TransitionPatchMask = 0;
+
+	// static lod of cached draw commands is selected by custom lod rule instead of screen size
+	bool bControllerLod = false;
 
 	ASandboxTerrainController* Controller;
 
@@ -312,9 +347,16 @@ public:
 
 	FVoxelMeshSceneProxy(UVoxelMeshComponent* Component) : FAbstractMeshSceneProxy(Component) {
 		ZoneOrigin = Component->GetComponentLocation();
+		FixedLodIndex = Component->FixedLodIndex;
+		TransitionPatchMask = Component->TransitionPatchMask;
+		bOccluded = Component->bOccluded;
+		bBatched = Component->bBatched;
+		MeshBox.Init();
 		Controller = Cast<ASandboxTerrainController>(Component->GetAttachmentRootActor());
 		if (Controller) {
+			bControllerLod = Controller->bPrecomputedLodTransitions;
 			CullDistance = Controller->ActiveAreaSize * 1.5 * USBT_ZONE_SIZE;
+			CullDepth = Controller->ActiveAreaDepth * 1.5 * USBT_ZONE_SIZE;
 			CopyAll(Component);
 		}
 	}
@@ -328,15 +370,12 @@ public:
 	}
 
 	template<class T>
-	void CopyMaterialMesh(UVoxelMeshComponent* Component, TMap<unsigned short, T>& MaterialMap, TMeshPtrArray& TargetMeshPtrArray, std::function<UMaterialInterface* (T)> GetMaterial) {
+	void CopyMaterialMesh(UVoxelMeshComponent* Component, const TMap<unsigned short, T>& MaterialMap, TMeshPtrArray& TargetMeshPtrArray, std::function<UMaterialInterface* (const T&)> GetMaterial) {
 		UMaterialInterface* DefaultMaterial = UMaterial::GetDefaultMaterial(MD_Surface);
 
-		for (auto& Element : MaterialMap) {
-			unsigned short MatId = Element.Key;
-			T& Section = Element.Value;
-
-			TMeshMaterialSection& SrcMaterialSection = static_cast<TMeshMaterialSection&>(Section);
-			FProcMeshSection& SourceMaterialSection = SrcMaterialSection.MaterialMesh;
+		for (const auto& Element : MaterialMap) {
+			const T& Section = Element.Value;
+			const TMeshMaterialSection& SrcMaterialSection = static_cast<const TMeshMaterialSection&>(Section);
 
 			UMaterialInterface* Material = GetMaterial(Section);
 			if (Material == nullptr) {
@@ -346,48 +385,84 @@ public:
 			FProcMeshProxySection* NewMaterialProxySection = new FProcMeshProxySection(GetScene().GetFeatureLevel());
 			NewMaterialProxySection->Material = Material;
 
-			CopySection(SourceMaterialSection, NewMaterialProxySection);
+			CopySection(SrcMaterialSection.RenderSection, NewMaterialProxySection);
 			TargetMeshPtrArray.Add(NewMaterialProxySection);
 		}
 	}
 
+	void CopyMergedMesh(const TMeshContainer& MeshContainer, TMeshPtrArray& TargetMeshPtrArray) {
+		if (!MeshContainer.MergedRenderSection) {
+			return;
+		}
+
+		FProcMeshProxySection* NewProxySection = new FProcMeshProxySection(GetScene().GetFeatureLevel());
+		NewProxySection->Material = Controller->MergedMaterial;
+
+		CopySection(MeshContainer.MergedRenderSection, NewProxySection);
+		TargetMeshPtrArray.Add(NewProxySection);
+	}
+
 	void CopyAll(UVoxelMeshComponent* Component) {
 		ASandboxTerrainController* TerrainController = Controller;
 
-		const int32 NumSections = Component->MeshSectionLodArray.Num();
+		// render sections are shared with mesh data, no mesh copy on component side
+		const TMeshDataPtr MeshDataPtr = Component->MeshDataPtr;
+		if (!MeshDataPtr) {
+			return;
+		}
+
+		const bool bMergeMaterials = TerrainController->IsMergedLodSections();
+		MeshDataPtr->PrepareRenderData(bMergeMaterials);
+
+		const FBox LocalBox = MeshDataPtr->GetLocalBox();
+		if (LocalBox.IsValid) {
+			MeshBox = LocalBox.TransformBy(Component->GetComponentTransform());
+		}
+
+		const int32 NumSections = MeshDataPtr->MeshSectionLodArray.Num();
 		if (NumSections == 0) {
 			return;
 		}
 
 		LodSectionArray.AddZeroed(NumSections);
 
+		// all lods and patches are uploaded once. lod state change does not recreate proxy
 		for (int SectionIdx = 0; SectionIdx < NumSections; SectionIdx++) {
 			FMeshProxyLodSection* NewLodSection = new FMeshProxyLodSection();
 
-			auto MatProviderR = [&TerrainController](TMeshMaterialSection Ms) { 
+			auto MatProviderR = [&TerrainController](const TMeshMaterialSection& Ms) { 
 				return TerrainController->GetRegularTerrainMaterial(Ms.MaterialId); 
 			};
 
-			auto MatProviderT = [&TerrainController](TMeshMaterialTransitionSection Ms) { 
+			auto MatProviderT = [&TerrainController](const TMeshMaterialTransitionSection& Ms) { 
 				return TerrainController->GetTransitionMaterial(Ms.MaterialIdSet); 
 			};
 
+			const TMeshLodSection& SrcLodSection = MeshDataPtr->MeshSectionLodArray[SectionIdx];
+
+			if (bMergeMaterials) {
+				// one section per lod and per patch
+				CopyMergedMesh(SrcLodSection.RegularMeshContainer, NewLodSection->MaterialMeshPtrArray);
+				for (auto I = 0; I < 6 && Component->bLodFlag; I++) {
+					CopyMergedMesh(SrcLodSection.TransitionPatchArray[I], NewLodSection->NormalPatchPtrArray[I]);
+				}
+
+				LodSectionArray[SectionIdx] = NewLodSection;
+				continue;
+			}
+
 			// copy regular material mesh
-			TMaterialSectionMap& MaterialMap = Component->MeshSectionLodArray[SectionIdx].RegularMeshContainer.MaterialSectionMap;
-			CopyMaterialMesh<TMeshMaterialSection>(Component, MaterialMap, NewLodSection->MaterialMeshPtrArray, MatProviderR);
+			CopyMaterialMesh<TMeshMaterialSection>(Component, SrcLodSection.RegularMeshContainer.MaterialSectionMap, NewLodSection->MaterialMeshPtrArray, MatProviderR);
 
 			// copy transition material mesh
-			TMaterialTransitionSectionMap& MaterialTransitionMap = Component->MeshSectionLodArray[SectionIdx].RegularMeshContainer.MaterialTransitionSectionMap;
-			CopyMaterialMesh<TMeshMaterialTransitionSection>(Component, MaterialTransitionMap, NewLodSection->MaterialMeshPtrArray, MatProviderT);
+			CopyMaterialMesh<TMeshMaterialTransitionSection>(Component, SrcLodSection.RegularMeshContainer.MaterialTransitionSectionMap, NewLodSection->MaterialMeshPtrArray, MatProviderT);
 
-			for (auto I = 0; I < 6; I++) {
+			for (auto I = 0; I < 6 && Component->bLodFlag; I++) {
 				// copy regular material mesh
-				TMaterialSectionMap& LodMaterialMap = Component->MeshSectionLodArray[SectionIdx].TransitionPatchArray[I].MaterialSectionMap;
-				CopyMaterialMesh<TMeshMaterialSection>(Component, LodMaterialMap, NewLodSection->NormalPatchPtrArray[I], MatProviderR);
+				CopyMaterialMesh<TMeshMaterialSection>(Component, SrcLodSection.TransitionPatchArray[I].MaterialSectionMap, NewLodSection->NormalPatchPtrArray[I], MatProviderR);
 
 				// copy transition material mesh
-				TMaterialTransitionSectionMap& LodMaterialTransitionMap = Component->MeshSectionLodArray[SectionIdx].TransitionPatchArray[I].MaterialTransitionSectionMap;
-				CopyMaterialMesh<TMeshMaterialTransitionSection>(Component, LodMaterialTransitionMap, NewLodSection->NormalPatchPtrArray[I], MatProviderT);
+				CopyMaterialMesh<TMeshMaterialTransitionSection>(Component, SrcLodSection.TransitionPatchArray[I].MaterialTransitionSectionMap, NewLodSection->NormalPatchPtrArray[I], MatProviderT);
 			}
 
 			// Save ref to new section
@@ -403,19 +478,56 @@ public:
 		}
 	}
 
+	void SetOccluded_RenderThread(const bool bNewOccluded) {
+		check(IsInRenderingThread());
+		bOccluded = bNewOccluded;
+	}
+
+	void SetBatched_RenderThread(const bool bNewBatched) {
+		check(IsInRenderingThread());
+		bBatched = bNewBatched;
+	}
+
+	void SetLodState_RenderThread(const int32 LodIndex, const uint8 PatchMask) {
+		check(IsInRenderingThread());
+		FixedLodIndex = LodIndex;
+		TransitionPatchMask = PatchMask;
+	}
+
+	// lod of existing mesh nearest to selected one
+	int32 GetFixedLodIndex() const {
+		int32 LodIndex = FMath::Min(FixedLodIndex, LodSectionArray.Num() - 1);
+		while (LodIndex > 0 && LodSectionArray[LodIndex] == nullptr) {
+			LodIndex--;
+		}
+
+		return LodIndex;
+	}
+
+	// distance from view to mesh box: horizontal by active area size, vertical by active area depth
 	bool CheckCullDistance(const FSceneView* View) const {
-		const FVector OriginXY(View->ViewMatrices.GetViewOrigin().X, View->ViewMatrices.GetViewOrigin().Y, 0);
-		const FVector ZoneOriginXY(ZoneOrigin.X, ZoneOrigin.Y, 0);
-		const float Distance = FVector::Distance(OriginXY, ZoneOriginXY);
-		return Distance <= CullDistance;
+		const FVector ViewOrigin = View->ViewMatrices.GetViewOrigin();
+		if (!MeshBox.IsValid) {
+			const FVector OriginXY(ViewOrigin.X, ViewOrigin.Y, 0);
+			const FVector ZoneOriginXY(ZoneOrigin.X, ZoneOrigin.Y, 0);
+			return FVector::Distance(OriginXY, ZoneOriginXY) <= CullDistance;
+		}
+
+		const FVector Delta = MeshBox.GetClosestPointTo(ViewOrigin) - ViewOrigin;
+		return Delta.X * Delta.X + Delta.Y * Delta.Y <= CullDistance * CullDistance && FMath::Abs(Delta.Z) <= CullDepth;
+	}
+
+	// primitive is frustum culled by whole zone bounds, mesh box is usually much smaller
+	bool CheckViewFrustum(const FSceneView* View) const {
+		return !MeshBox.IsValid || View->ViewFrustum.IntersectBox(MeshBox.GetCenter(), MeshBox.GetExtent());
 	}
 
 	virtual FPrimitiveViewRelevance GetViewRelevance(const FSceneView* View) const {
 		FPrimitiveViewRelevance Result;
 
-		Result.bDrawRelevance = CheckCullDistance(View) && IsShown(View);
-		Result.bShadowRelevance = IsShadowCast(View);
-		Result.bDynamicRelevance = true;
+		Result.bDrawRelevance = !bOccluded && !bBatched && CheckCullDistance(View) && CheckViewFrustum(View) && IsShown(View);
+		Result.bShadowRelevance = !bBatched && IsShadowCast(View);
+		Result.bDynamicRelevance = FixedLodIndex < 0 || TransitionPatchMask != 0;
 		Result.bStaticRelevance = true;
 		Result.bRenderInMainPass = ShouldRenderInMainPass();
 		Result.bUsesLightingChannels = GetLightingChannelMask() != GetDefaultLightingChannelMask();
@@ -442,6 +554,28 @@ public:
 		return I;
 	}
 
+	virtual bool IsUsingCustomLODRules() const override {
+		return bControllerLod;
+	}
+
+	// static lod selected by controller, no draw command recaching on change. screen size lod until first selection
+	virtual FLODMask GetCustomLOD(const FSceneView& InView, float InViewLODScale, int32 InForcedLODLevel, float& OutScreenSizeSquared) const override {
+		const FBoxSphereBounds& ProxyBounds = GetBounds();
+		const float ScreenSize = ComputeBoundsScreenSize(ProxyBounds.Origin, ProxyBounds.SphereRadius, InView);
+		OutScreenSizeSquared = ScreenSize * ScreenSize;
+
+		FLODMask LODMask;
+		if (InForcedLODLevel >= 0) {
+			LODMask.SetLOD(FMath::Min(InForcedLODLevel, LOD_ARRAY_SIZE - 1));
+		} else if (FixedLodIndex >= 0) {
+			LODMask.SetLOD(GetFixedLodIndex());
+		} else {
+			LODMask.SetLOD(ComputeLodIndexByScreenSize(&InView, ProxyBounds.Origin));
+		}
+
+		return LODMask;
+	}
+
 	//================================================================================================
 	// Draw main zone as static mesh
 	//================================================================================================
@@ -461,6 +595,33 @@ public:
 		}
 	}
 
+	// patches of selected lod to finer neighbors
+	void DrawFixedLodPatches(const TArray<const FSceneView*>& Views, uint32 VisibilityMap, FMeshElementCollector& Collector) const {
+		const int32 LodIndex = GetFixedLodIndex();
+		if (LodIndex <= 0 || TransitionPatchMask == 0) {
+			return;
+		}
+
+		const FMeshProxyLodSection* LodSection = LodSectionArray[LodIndex];
+		for (int32 ViewIndex = 0; ViewIndex < Views.Num(); ViewIndex++) {
+			if ((VisibilityMap & (1 << ViewIndex)) == 0) {
+				continue;
+			}
+
+			for (auto I = 0; I < 6; I++) {
+				if ((TransitionPatchMask & (1 << I)) == 0) {
+					continue;
+				}
+
+				for (FProcMeshProxySection* MatSection : LodSection->NormalPatchPtrArray[I]) {
+					if (MatSection != nullptr && MatSection->Material != nullptr) {
+						DrawDynamicMeshSection(MatSection, Collector, MatSection->Material->GetRenderProxy(), false, ViewIndex);
+					}
+				}
+			}
+		}
+	}
+
 	//================================================================================================
 	// Draw transvoxel patches as dynamic mesh  
 	//================================================================================================
@@ -470,6 +631,11 @@ public:
 			return;
 		}
 
+		if (FixedLodIndex >= 0) {
+			DrawFixedLodPatches(Views, VisibilityMap, Collector);
+			return;
+		}
+
 		for (int32 ViewIndex = 0; ViewIndex < Views.Num(); ViewIndex++) {
 			//DrawBox(Collector, ViewIndex, FLinearColor::Blue, ZoneOrigin);
 
@@ -501,4 +667,156 @@ public:
 		}
 	}
 
-};
\ No newline at end of file
+};
+
+// ================================================================================================================================================
+// FFarTerrainSceneProxy
+// ================================================================================================================================================
+
+class FFarTerrainSceneProxy final : public FAbstractMeshSceneProxy {
+
+private:
+
+	/** whole region mesh in one buffer */
+	FProcMeshProxySection* MeshSection = nullptr;
+
+	TArray<uint32> CellFirstIndex;
+
+	TArray<FBox> CellBox;
+
+	// cells covered by loaded zones
+	TBitArray<> CoveredCellMask;
+
+	bool bAnyCovered = false;
+
+public:
+
+	FFarTerrainSceneProxy(UFarTerrainComponent* Component) : FAbstractMeshSceneProxy(Component) {
+		SetCoveredCells_RenderThread(Component->CoveredCellMask);
+
+		TFarTerrainMeshDataPtr MeshDataPtr = Component->MeshDataPtr;
+		CellFirstIndex = MeshDataPtr->CellFirstIndex;
+		CellBox = MeshDataPtr->CellBox;
+
+		MeshSection = new FProcMeshProxySection(GetScene().GetFeatureLevel());
+		MeshSection->Material = Component->FarTerrainMaterial;
+		CopySection(MeshDataPtr->RenderSection ? MeshDataPtr->RenderSection : BuildMeshRenderSection(MeshDataPtr->Mesh), MeshSection);
+	}
+
+	virtual ~FFarTerrainSceneProxy() {
+		if (MeshSection != nullptr) {
+			delete MeshSection;
+		}
+	}
+
+	virtual FPrimitiveViewRelevance GetViewRelevance(const FSceneView* View) const {
+		FPrimitiveViewRelevance Result;
+
+		Result.bDrawRelevance = IsShown(View);
+		Result.bShadowRelevance = IsShadowCast(View);
+		Result.bDynamicRelevance = true;
+		Result.bRenderInMainPass = ShouldRenderInMainPass();
+		Result.bUsesLightingChannels = GetLightingChannelMask() != GetDefaultLightingChannelMask();
+		Result.bRenderCustomDepth = ShouldRenderCustomDepth();
+		MaterialRelevance.SetPrimitiveViewRelevance(Result);
+		return Result;
+	}
+
+	void SetCoveredCells_RenderThread(const TBitArray<>& NewCoveredCellMask) {
+		CoveredCellMask = NewCoveredCellMask;
+		bAnyCovered = CoveredCellMask.Find(true) != INDEX_NONE;
+	}
+
+	bool IsCellCovered(const int32 CellIdx) const {
+		return CoveredCellMask.IsValidIndex(CellIdx) && CoveredCellMask[CellIdx];
+	}
+
+	//================================================================================================
+	// Draw visible cells. neighbor visible cells are drawn as one index range
+	//================================================================================================
+
+	virtual void GetDynamicMeshElements(const TArray<const FSceneView*>& Views, const FSceneViewFamily& ViewFamily, uint32 VisibilityMap, FMeshElementCollector& Collector) const override {
+		if (MeshSection == nullptr || MeshSection->Material == nullptr || CellBox.Num() == 0) {
+			return;
+		}
+
+		FMaterialRenderProxy* MaterialProxy = MeshSection->Material->GetRenderProxy();
+
+		for (int32 ViewIndex = 0; ViewIndex < Views.Num(); ViewIndex++) {
+			if (VisibilityMap & (1 << ViewIndex)) {
+				if (!bAnyCovered) {
+					DrawDynamicMeshSection(MeshSection, Collector, MaterialProxy, false, ViewIndex, 0, CellFirstIndex.Last() / 3);
+					continue;
+				}
+
+				int32 RangeStart = -1;
+				for (int32 CellIdx = 0; CellIdx <= CellBox.Num(); CellIdx++) {
+					const bool bVisible = CellIdx < CellBox.Num() && !IsCellCovered(CellIdx);
+					if (bVisible && RangeStart < 0) {
+						RangeStart = CellIdx;
+					}
+
+					if (!bVisible && RangeStart >= 0) {
+						const uint32 FirstIndex = CellFirstIndex[RangeStart];
+						const uint32 NumPrimitives = (CellFirstIndex[CellIdx] - FirstIndex) / 3;
+						DrawDynamicMeshSection(MeshSection, Collector, MaterialProxy, false, ViewIndex, FirstIndex, NumPrimitives);
+						RangeStart = -1;
+					}
+				}
+			}
+		}
+	}
+
+};
+
+// ================================================================================================================================================
+// FTerrainBatchSceneProxy
+// ================================================================================================================================================
+
+class FTerrainBatchSceneProxy final : public FAbstractMeshSceneProxy {
+
+private:
+
+	TArray<FProcMeshProxySection*> SectionArray;
+
+public:
+
+	FTerrainBatchSceneProxy(UTerrainBatchComponent* Component) : FAbstractMeshSceneProxy(Component) {
+		const TZoneBatchMeshDataPtr MeshDataPtr = Component->MeshDataPtr;
+		for (int32 Idx = 0; Idx < MeshDataPtr->SectionArray.Num(); Idx++) {
+			FProcMeshProxySection* NewSection = new FProcMeshProxySection(GetScene().GetFeatureLevel());
+			NewSection->Material = Component->SectionMaterials.IsValidIndex(Idx) ? Component->SectionMaterials[Idx] : nullptr;
+			CopySection(MeshDataPtr->SectionArray[Idx].RenderSection, NewSection);
+			SectionArray.Add(NewSection);
+		}
+	}
+
+	virtual ~FTerrainBatchSceneProxy() {
+		for (FProcMeshProxySection* Section : SectionArray) {
+			delete Section;
+		}
+	}
+
+	virtual FPrimitiveViewRelevance GetViewRelevance(const FSceneView* View) const {
+		FPrimitiveViewRelevance Result;
+
+		Result.bDrawRelevance = IsShown(View);
+		Result.bShadowRelevance = IsShadowCast(View);
+		Result.bStaticRelevance = true;
+		Result.bRenderInMainPass = ShouldRenderInMainPass();
+		Result.bUsesLightingChannels = GetLightingChannelMask() != GetDefaultLightingChannelMask();
+		Result.bRenderCustomDepth = ShouldRenderCustomDepth();
+		MaterialRelevance.SetPrimitiveViewRelevance(Result);
+		return Result;
+	}
+
+	// single lod, whole batch is already far
+	virtual void DrawStaticElements(FStaticPrimitiveDrawInterface* PDI) {
+		for (FProcMeshProxySection* Section : SectionArray) {
+			if (Section->VertexBuffers.PositionVertexBuffer.GetNumVertices() > 0) {
+				DrawStaticMeshSection(PDI, Section, 0, MAX_FLT);
+			}
+		}
+	}
+
+};
@@ -175,6 +175,21 @@ float UTerrainGeneratorComponent::FunctionMakeBox(const float InDensity, const F
 	return R;
 };
 
+// world space bounds of vertical cylinder as in FunctionMakeVerticalCylinder, which is evaluated in space rotated by Rotator around Origin
+static FBox ClcCylinderBounds(const FVector& Origin, const float Radius, const float Top, const float Bottom, const FRotator& Rotator) {
+	static const float E = 50;
+	const float R = Radius + E;
+	const FBox LocalBox(FVector(-R, -R, Bottom - E), FVector(R, R, Top + E));
+
+	FBox Bounds(ForceInit);
+	for (int I = 0; I < 8; I++) {
+		const FVector Corner((I & 1) ? LocalBox.Max.X : LocalBox.Min.X, (I & 2) ? LocalBox.Max.Y : LocalBox.Min.Y, (I & 4) ? LocalBox.Max.Z : LocalBox.Min.Z);
+		Bounds += Origin + Rotator.UnrotateVector(Corner);
+	}
+
+	return Bounds.ExpandBy(1.f); // rounding
+}
+
 void StructureHotizontalBoxTunnel(TStructuresGenerator* Generator, const FBox TunnelBox, TSet<TVoxelIndex>& Res) {
 
 	const UTerrainGeneratorComponent* Generator2 = (UTerrainGeneratorComponent*)Generator->GetGeneratorComponent();
@@ -187,7 +202,7 @@ void StructureHotizontalBoxTunnel(TStructuresGenerator* Generator, const FBox Tu
 
 	TZoneStructureHandler Str;
 	Str.Function = Function;
-	//Str.Box = TunnelBox;
+	Str.Bounds = TunnelBox.ExpandBy(50); // same as E in FunctionMakeBox
 
 	const TVoxelIndex MinIndex = Generator->GetController()->GetZoneIndex(TunnelBox.Min);
 	const TVoxelIndex MaxIndex = Generator->GetController()->GetZoneIndex(TunnelBox.Max);
@@ -225,6 +240,7 @@ void StructureVerticalCylinderTunnel(TStructuresGenerator* Generator, const FVec
 	Str.Function = Function;
 	Str.LandscapeFoliageFilter = Function2;
 	Str.Pos = Origin;
+	Str.Bounds = ClcCylinderBounds(Origin, Radius, Top, Bottom, FRotator(0));
 
 	FVector Min(Origin);
 	Min.Z += Bottom;
@@ -280,6 +296,7 @@ void StructureDiagonalCylinderTunnel(TStructuresGenerator* Generator, const FVec
 	Str.Function = Function;
 	Str.LandscapeFoliageFilter = Function2;
 	Str.Pos = Origin;
+	Str.Bounds = ClcCylinderBounds(Origin, Radius, Top, Bottom * 1.414213 - 350, DirRotation[Dir]);
 
 	FVector Min(Origin);
 	Min.Z += Bottom;
@@ -136,6 +136,8 @@ void UTerrainGeneratorComponent::BeginPlay() {
     LastLayer.Name = TEXT("");
     UndergroundLayersTmp.Add(LastLayer);
 
+    PrepareMaterialLayers();
+
     PrepareMetaData();
 }
 
@@ -226,13 +228,57 @@ int UTerrainGeneratorComponent::GetMaterialLayers(const TChunkDataPtr ChunkData,
     return Cnt;
 }
 
+void UTerrainGeneratorComponent::PrepareMaterialLayers() {
+    UndergroundLayerDepthTmp.clear();
+    UndergroundLayerDepthTmp.reserve(UndergroundLayersTmp.Num());
+
+    bUndergroundLayersSorted = true;
+    for (int Idx = 0; Idx < UndergroundLayersTmp.Num(); Idx++) {
+        const float StartDepth = UndergroundLayersTmp[Idx].StartDepth;
+        if (Idx > 0 && StartDepth < UndergroundLayerDepthTmp.back()) {
+            bUndergroundLayersSorted = false;
+        }
+
+        UndergroundLayerDepthTmp.push_back(StartDepth);
+    }
+
+    if (!bUndergroundLayersSorted) {
+        UE_LOG(LogVt, Warning, TEXT("Underground layers are not sorted by StartDepth. Slow material lookup is used"));
+    }
+}
+
 const FTerrainUndergroundLayer* UTerrainGeneratorComponent::GetMaterialLayer(float Z, float RealGroundLevel)  const {
-    for (int Idx = 0; Idx < UndergroundLayersTmp.Num() - 1; Idx++) {
-        const FTerrainUndergroundLayer& Layer = UndergroundLayersTmp[Idx];
-        if (Z <= RealGroundLevel - Layer.StartDepth && Z > RealGroundLevel - UndergroundLayersTmp[Idx + 1].StartDepth) {
-            return &Layer;
+    const int Num = UndergroundLayersTmp.Num() - 1; // last one is terminator
+
+    if (!bUndergroundLayersSorted) {
+        for (int Idx = 0; Idx < Num; Idx++) {
+            const FTerrainUndergroundLayer& Layer = UndergroundLayersTmp[Idx];
+            if (Z <= RealGroundLevel - Layer.StartDepth && Z > RealGroundLevel - UndergroundLayersTmp[Idx + 1].StartDepth) {
+                return &Layer;
+            }
+        }
+        return nullptr;
+    }
+
+    // layers sorted by depth: (Z <= RealGroundLevel - StartDepth) is true for prefix only 
+    // so the last layer of this prefix is the only one can match. same comparisons as linear scan
+    const float* Depth = UndergroundLayerDepthTmp.data();
+    int Lo = 0;
+    int Hi = Num;
+    while (Lo < Hi) {
+        const int Mid = (Lo + Hi) >> 1;
+        if (Z <= RealGroundLevel - Depth[Mid]) {
+            Lo = Mid + 1;
+        } else {
+            Hi = Mid;
         }
     }
+
+    const int Idx = Lo - 1;
+    if (Idx >= 0 && Z > RealGroundLevel - Depth[Idx + 1]) {
+        return &UndergroundLayersTmp[Idx];
+    }
+
     return nullptr;
 }
 
@@ -256,6 +302,14 @@ FORCEINLINE TMaterialId UTerrainGeneratorComponent::MaterialFuncionExt(const TGe
     return  MatId;
 }
 
+void UTerrainGeneratorComponent::MaterialFuncionExtColumn(const TGenerateVdTempItm& Itm, const int X, const int Y, const int S, TMaterialId* MaterialColumn) const {
+    const TVoxelData* Vd = Itm.Vd;
+    for (int Z = 0; Z < ZoneVoxelResolution; Z += S) {
+        const FVector& WorldPos = Vd->voxelIndexToVector(X, Y, Z) + Vd->getOrigin();
+        MaterialColumn[Z] = MaterialFuncionExt(&Itm, MaterialColumn[Z], WorldPos, TVoxelIndex(X, Y, Z));
+    }
+}
+
 //======================================================================================================================================================================
 // Density
 //======================================================================================================================================================================
@@ -278,29 +332,113 @@ FORCEINLINE float UTerrainGeneratorComponent::DensityFunctionExt(float InDensity
     return InDensity;
 }
 
-FORCEINLINE float UTerrainGeneratorComponent::ClcDensityByGroundLevel(const FVector& V, const float GroundLevel) const {
-    const float Z = V.Z;
-    const float D = Z - GroundLevel;
+void UTerrainGeneratorComponent::DensityFunctionExtColumn(const TGenerateVdTempItm& Itm, const int X, const int Y, const int S, float* DensityColumn) const {
+    const TVoxelData* Vd = Itm.Vd;
+    for (int Z = 0; Z < ZoneVoxelResolution; Z += S) {
+        const TVoxelIndex Index(X, Y, Z);
+        const FVector& LocalPos = Vd->voxelIndexToVector(X, Y, Z);
+        const FVector& WorldPos = LocalPos + Vd->getOrigin();
+        DensityColumn[Z] = DensityFunctionExt(DensityColumn[Z], std::make_tuple(Itm.ZoneIndex, Index, WorldPos, LocalPos, Itm.ChunkData));
+    }
+}
+
+#define USBT_DENSITY_TABLE_RANGE    500
+#define USBT_DENSITY_TABLE_STEP     0.5f
+
+// Density by ground level depends only on D = Z - GroundLevel: 1 - 1 / (1 + exp(-D / 20)), 1 below -500 and 0 above 500.
+// Table is sampled by the exact formula and linear interpolated. Max error is step^2 / 8 * max|f''| = 0.25 / 8 * 2.4e-4 < 1e-5, 
+// far below density byte quantization (1/255). Samples where exact formula gives 1 or 0 stay exact, so solid/empty runs are exact too.
+class TDensityByGroundLevelTable {
+
+private:
+
+    static constexpr int Size = (int)(2 * USBT_DENSITY_TABLE_RANGE / USBT_DENSITY_TABLE_STEP) + 1;
+
+    float Table[Size + 1];
+
+    static float ClcExact(const float D) {
+        float Density = 1 - (1 / (1 + exp(-D / 20)));
+        TRIM_FLOAT_VAL(Density);
+        return Density;
+    }
+
+public:
+
+    // D <= SolidLimit always gives 1, D >= EmptyLimit always gives 0
+    float SolidLimit = -USBT_DENSITY_TABLE_RANGE;
+    float EmptyLimit = USBT_DENSITY_TABLE_RANGE;
+
+    TDensityByGroundLevelTable() {
+        for (int I = 0; I < Size; I++) {
+            Table[I] = ClcExact(-USBT_DENSITY_TABLE_RANGE + I * USBT_DENSITY_TABLE_STEP);
+        }
+
+        Table[Size] = Table[Size - 1];
+
+        int Solid = 0;
+        while (Solid < Size - 1 && Table[Solid + 1] == 1.f) {
+            Solid++;
+        }
+
+        int Empty = Size - 1;
+        while (Empty > 0 && Table[Empty - 1] == 0.f) {
+            Empty--;
+        }
+
+        SolidLimit = -USBT_DENSITY_TABLE_RANGE + Solid * USBT_DENSITY_TABLE_STEP;
+        EmptyLimit = -USBT_DENSITY_TABLE_RANGE + Empty * USBT_DENSITY_TABLE_STEP;
+    }
+
+    FORCEINLINE float Get(const float D) const {
+        if (D > USBT_DENSITY_TABLE_RANGE) {
+            return 0.f;
+        }
+
+        if (D < -USBT_DENSITY_TABLE_RANGE) {
+            return 1.f;
+        }
 
-    if (D > 500) {
-        return 0.f;
+        const float T = (D + USBT_DENSITY_TABLE_RANGE) * (1.f / USBT_DENSITY_TABLE_STEP);
+        const int I = (int)T;
+        const float F = T - (float)I;
+        const float A = Table[I];
+        return A + (Table[I + 1] - A) * F;
     }
 
-    if (D < -500) {
-        return 1.f;
+    static const TDensityByGroundLevelTable& Instance() {
+        static const TDensityByGroundLevelTable Tbl;
+        return Tbl;
     }
+};
+
+FORCEINLINE float UTerrainGeneratorComponent::ClcDensityByGroundLevel(const FVector& V, const float GroundLevel) const {
+    const float D = V.Z - GroundLevel;
+    return TDensityByGroundLevelTable::Instance().Get(D);
+}
+
+// fill density along Z column: StartZ + I * Step, I = 0..Num-1
+void UTerrainGeneratorComponent::ClcDensityColumnByGroundLevel(const float GroundLevel, const float StartZ, const float Step, const int Num, float* OutDensity) const {
+    const TDensityByGroundLevelTable& Tbl = TDensityByGroundLevelTable::Instance();
 
-    float DensityByGroundLevel = 1 - (1 / (1 + exp(-(Z - GroundLevel) / 20)));
+    // solid run below ground
+    int SolidNum = FMath::Clamp((int)FMath::FloorToFloat((GroundLevel + Tbl.SolidLimit - StartZ) / Step) + 1, 0, Num);
+    while (SolidNum > 0 && (StartZ + (SolidNum - 1) * Step) - GroundLevel > Tbl.SolidLimit) {
+        SolidNum--;
+    }
 
-    if (DensityByGroundLevel > 1.f) {
-        DensityByGroundLevel = 1.f;
+    // empty run above ground
+    int EmptyStart = FMath::Clamp((int)FMath::CeilToFloat((GroundLevel + Tbl.EmptyLimit - StartZ) / Step), SolidNum, Num);
+    while (EmptyStart < Num && (StartZ + EmptyStart * Step) - GroundLevel < Tbl.EmptyLimit) {
+        EmptyStart++;
     }
 
-    if (DensityByGroundLevel < 0.f) {
-        DensityByGroundLevel = 0.f;
+    std::fill(OutDensity, OutDensity + SolidNum, 1.f);
+
+    for (int I = SolidNum; I < EmptyStart; I++) {
+        OutDensity[I] = Tbl.Get((StartZ + I * Step) - GroundLevel);
     }
 
-    return DensityByGroundLevel;
+    std::fill(OutDensity + EmptyStart, OutDensity + Num, 0.f);
 }
 
 TChunkDataPtr UTerrainGeneratorComponent::NewChunkData() {
@@ -381,6 +519,50 @@ struct TMinMax {
     }
 };
 
+// Per worker thread temporaries of generator. Reset and reused by each zone instead of allocation per zone
+struct TGeneratorScratch {
+
+    std::vector<uint8> OctreeMarks;
+
+    std::vector<float> DensityColumn;
+
+    std::vector<TMaterialId> MaterialColumn;
+
+    std::vector<const TZoneStructureHandler*> ZoneStructures;
+
+    std::vector<const TZoneStructureHandler*> ColumnStructures;
+
+    uint8* ResetOctreeMarks(const int Total) {
+        if ((int)OctreeMarks.size() < Total) {
+            OctreeMarks.resize(Total);
+        }
+
+        memset(OctreeMarks.data(), 0x0, Total);
+        return OctreeMarks.data();
+    }
+
+    float* GetDensityColumn(const int Num) {
+        if ((int)DensityColumn.size() < Num) {
+            DensityColumn.resize(Num);
+        }
+
+        return DensityColumn.data();
+    }
+
+    TMaterialId* GetMaterialColumn(const int Num) {
+        if ((int)MaterialColumn.size() < Num) {
+            MaterialColumn.resize(Num);
+        }
+
+        return MaterialColumn.data();
+    }
+
+    static TGeneratorScratch& Get() {
+        thread_local TGeneratorScratch Scratch;
+        return Scratch;
+    }
+};
+
 FORCEINLINE int ClcZ(float Gl, float ZonePosZ, float Step, int S, int D) {
     const float H = Gl - ZonePosZ;
     int Z = (int)(H / Step) + (D / 2) - 1;
@@ -393,13 +575,17 @@ FORCEINLINE int ClcZ(float Gl, float ZonePosZ, float Step, int S, int D) {
     return Z;
 };
 
+template<typename THandler, typename TCheckVoxel>
 class TPseudoOctree {
 
 private:
 
+    THandler Handler;
+    TCheckVoxel CheckVoxel;
+
     TVoxelData* VoxelData;
     int Total;
-    int* Processed;
+    uint8* Processed;
     int Count = 0;
 
     void PerformVoxel(const TVoxelIndex& Parent, const int LOD) {
@@ -435,23 +621,10 @@ private:
 
 public:
 
-    std::function<void(const TVoxelIndex&, int, TVoxelData*, int)> Handler = nullptr;
-    std::function<bool(const TVoxelIndex&, int, int, const TVoxelData*)> CheckVoxel = nullptr;
-
-    TPseudoOctree(TVoxelData* Vd) : VoxelData(Vd) {
+    TPseudoOctree(TVoxelData* Vd, THandler InHandler, TCheckVoxel InCheckVoxel) : Handler(InHandler), CheckVoxel(InCheckVoxel), VoxelData(Vd) {
         int N = Vd->num();
         Total = N * N * N;
-        Processed = new int[Total];
-        for (int I = 0; I < Total; I++) {
-            Processed[I] = 0x0;
-        }
-
-        Handler = [](const TVoxelIndex& V, int Idx, TVoxelData* VoxelData_, int LOD) {  };
-        CheckVoxel = [](const TVoxelIndex& V, int S, int LOD, const TVoxelData* VoxelData_) { return true;  };
-    };
-
-    ~TPseudoOctree() {
-        delete Processed;
+        Processed = TGeneratorScratch::Get().ResetOctreeMarks(Total);
     };
 
     void Start() {
@@ -478,16 +651,11 @@ void UTerrainGeneratorComponent::GenerateLandscapeZoneSlight(const TGenerateVdTe
     VoxelData->initializeDensity();
     VoxelData->deinitializeMaterial(DfaultGrassMaterialId);
 
-    TPseudoOctree Octree(VoxelData);
-    Octree.Handler = [=, this] (const TVoxelIndex& V, int Idx, TVoxelData* VoxelData, int LOD) {
-        if (LOD == 0) {
-            const FVector& LocalPos = VoxelData->voxelIndexToVector(V.X, V.Y, V.Z);
-            const FVector& WorldPos = LocalPos + VoxelData->getOrigin();
-        }
+    const auto Handler = [&, this] (const TVoxelIndex& V, int Idx, TVoxelData* VoxelData, int LOD) {
        B(ZoneIndex, V, VoxelData, ChunkData);
     };
 
-    Octree.CheckVoxel = [=](const TVoxelIndex& V, int S, int LOD, const TVoxelData* Vd) {
+    const auto CheckVoxel = [&](const TVoxelIndex& V, int S, int LOD, const TVoxelData* Vd) {
         if (LOD > 3) {
             return true;
         }
@@ -515,6 +683,7 @@ void UTerrainGeneratorComponent::GenerateLandscapeZoneSlight(const TGenerateVdTe
         return R;
     };
 
+    TPseudoOctree<decltype(Handler), decltype(CheckVoxel)> Octree(VoxelData, Handler, CheckVoxel);
     Octree.Start();
     VoxelData->setCacheToValid();
 
@@ -590,43 +759,74 @@ void UTerrainGeneratorComponent::GenerateZoneVolumeWithFunction(const TGenerateV
 
     bool bIsLandscape = IsLandscapeZone(VoxelData->getOrigin(), ChunkData);
 
+    float BaseDensity = (Itm.Type == TZoneGenerationType::AirOnly) ? 0. : 1.f;
+    if (Itm.Type == TZoneGenerationType::Other) {
+        const FVector& Pos = GetController()->GetZonePos(ZoneIndex);
+        if (ChunkData->GetMaxHeightLevel() < Pos.Z - ZoneHalfSize) {
+            BaseDensity = 0.f;
+        }
+    }
+
+    const float Step = VoxelData->size() / (VoxelData->num() - 1);
+    const float StartZ = VoxelData->getOrigin().Z - VoxelData->size() / 2;
+    TGeneratorScratch& Scratch = TGeneratorScratch::Get();
+    float* DensityColumn = Scratch.GetDensityColumn(ZoneVoxelResolution);
+    TMaterialId* MaterialColumn = Scratch.GetMaterialColumn(ZoneVoxelResolution);
+
+    // only structures which bounds overlap zone, then only ones overlap column
+    const FVector ZoneOrigin = VoxelData->getOrigin();
+    const FBox ZoneBox(ZoneOrigin - FVector(ZoneHalfSize), ZoneOrigin + FVector(ZoneHalfSize));
+
+    auto& ZoneStructures = Scratch.ZoneStructures;
+    ZoneStructures.clear();
+    for (const auto& StructureHandler : StructureList) {
+        if (StructureHandler.Function && (!StructureHandler.Bounds.IsValid || StructureHandler.Bounds.Intersect(ZoneBox))) {
+            ZoneStructures.push_back(&StructureHandler);
+        }
+    }
+
+    auto& ColumnStructures = Scratch.ColumnStructures;
+
     for (int X = 0; X < ZoneVoxelResolution; X += S) {
         for (int Y = 0; Y < ZoneVoxelResolution; Y += S) {
+            const float GroundLevel = ChunkData->GetHeightLevel(X, Y);
+
+            const FVector ColumnPos = VoxelData->voxelIndexToVector(X, Y, 0) + ZoneOrigin;
+            ColumnStructures.clear();
+            for (const TZoneStructureHandler* StructureHandler : ZoneStructures) {
+                const FBox& B = StructureHandler->Bounds;
+                if (!B.IsValid || (ColumnPos.X >= B.Min.X && ColumnPos.X <= B.Max.X && ColumnPos.Y >= B.Min.Y && ColumnPos.Y <= B.Max.Y)) {
+                    ColumnStructures.push_back(StructureHandler);
+                }
+            }
+
+            if (bIsLandscape) {
+                ClcDensityColumnByGroundLevel(GroundLevel, StartZ, Step, ZoneVoxelResolution, DensityColumn);
+            } else {
+                std::fill(DensityColumn, DensityColumn + ZoneVoxelResolution, BaseDensity);
+            }
+
             for (int Z = 0; Z < ZoneVoxelResolution; Z += S) {
-                const TVoxelIndex& Index = TVoxelIndex(X, Y, Z);
+                const TVoxelIndex Index(X, Y, Z);
                 const FVector& LocalPos = VoxelData->voxelIndexToVector(X, Y, Z);
                 const FVector& WorldPos = LocalPos + VoxelData->getOrigin();
-                const float GroundLevel = ChunkData->GetHeightLevel(X, Y);
-
-                float Density = (Itm.Type == TZoneGenerationType::AirOnly) ? 0. : 1.f;
-
-                if (Itm.Type == TZoneGenerationType::Other) {
-                    const FVector& Pos = GetController()->GetZonePos(ZoneIndex);
-                    if (ChunkData->GetMaxHeightLevel() < Pos.Z - ZoneHalfSize){
-                        Density = 0.f;
-                    }
-                }
 
+                float Density = DensityColumn[Z];
                 TMaterialId MaterialId = MaterialFuncion(ZoneIndex, WorldPos, GroundLevel);
 
-                if (bIsLandscape) {
-                    Density = ClcDensityByGroundLevel(WorldPos, GroundLevel);
-                }
-
-                for (const auto& StructureHandler : StructureList) {
-                    if (StructureHandler.Function) {
-                        auto R = StructureHandler.Function(Density, MaterialId, Index, LocalPos, WorldPos);
-                        Density = std::get<0>(R);
-                        MaterialId = std::get<1>(R);
+                for (const TZoneStructureHandler* StructureHandler : ColumnStructures) {
+                    const FBox& B = StructureHandler->Bounds;
+                    if (B.IsValid && (WorldPos.Z < B.Min.Z || WorldPos.Z > B.Max.Z)) {
+                        continue;
                     }
-                }
 
-                MaterialId = MaterialFuncionExt(&Itm, MaterialId, WorldPos, Index);
-
-                const float Density2 = DensityFunctionExt(Density, std::make_tuple(ZoneIndex, Index, WorldPos, LocalPos, ChunkData));
+                    auto R = StructureHandler->Function(Density, MaterialId, Index, LocalPos, WorldPos);
+                    Density = std::get<0>(R);
+                    MaterialId = std::get<1>(R);
+                }
 
-                VoxelData->setDensityAndMaterial(Index, Density2, MaterialId);
-                VoxelData->performSubstanceCacheLOD(Index.X, Index.Y, Index.Z, LOD);
+                DensityColumn[Z] = Density;
+                MaterialColumn[Z] = MaterialId;
 
                 if (Density == 0) {
                     zc++;
@@ -635,6 +835,16 @@ void UTerrainGeneratorComponent::GenerateZoneVolumeWithFunction(const TGenerateV
                 if (Density == 1) {
                     fc++;
                 }
+            }
+
+            MaterialFuncionExtColumn(Itm, X, Y, S, MaterialColumn);
+            DensityFunctionExtColumn(Itm, X, Y, S, DensityColumn);
+
+            for (int Z = 0; Z < ZoneVoxelResolution; Z += S) {
+                const TMaterialId MaterialId = MaterialColumn[Z];
+
+                VoxelData->setDensityAndMaterial(TVoxelIndex(X, Y, Z), DensityColumn[Z], MaterialId);
+                VoxelData->performSubstanceCacheLOD(X, Y, Z, LOD);
 
                 if (!BaseMaterialId) {
                     BaseMaterialId = MaterialId;
@@ -689,22 +899,38 @@ void UTerrainGeneratorComponent::GenerateZoneVolume(const TGenerateVdTempItm& It
     VoxelData->initializeDensity();
     VoxelData->initializeMaterial();
 
+    const float Step = VoxelData->size() / (VoxelData->num() - 1);
+    const float StartZ = VoxelData->getOrigin().Z - VoxelData->size() / 2;
+    TGeneratorScratch& Scratch = TGeneratorScratch::Get();
+    float* DensityColumn = Scratch.GetDensityColumn(ZoneVoxelResolution);
+    TMaterialId* MaterialColumn = Scratch.GetMaterialColumn(ZoneVoxelResolution);
+
     for (int X = 0; X < ZoneVoxelResolution; X += S) {
         for (int Y = 0; Y < ZoneVoxelResolution; Y += S) {
+            const float GroundLevel = ChunkData->GetHeightLevel(X, Y);
+
+            ClcDensityColumnByGroundLevel(GroundLevel, StartZ, Step, ZoneVoxelResolution, DensityColumn);
+            DensityFunctionExtColumn(Itm, X, Y, S, DensityColumn);
+
             for (int Z = 0; Z < ZoneVoxelResolution; Z += S) {
-                const FVector& LocalPos = VoxelData->voxelIndexToVector(X, Y, Z);
-                const TVoxelIndex& Index = TVoxelIndex(X, Y, Z);
+                const FVector& WorldPos = VoxelData->voxelIndexToVector(X, Y, Z) + VoxelData->getOrigin();
+                MaterialColumn[Z] = MaterialFuncion(ZoneIndex, WorldPos, GroundLevel);
+            }
 
-                auto R = A(ZoneIndex, Index, VoxelData, Itm);
-                float Density = std::get<2>(R);
-                TMaterialId MaterialId = std::get<3>(R);
+            MaterialFuncionExtColumn(Itm, X, Y, S, MaterialColumn);
+
+            for (int Z = 0; Z < ZoneVoxelResolution; Z += S) {
+                const float Density = DensityColumn[Z];
+                const TMaterialId MaterialId = MaterialColumn[Z];
+
+                VoxelData->setDensityAndMaterial(TVoxelIndex(X, Y, Z), Density, MaterialId);
 
                 if (LOD > 0) {
                    // MaterialId = DfaultGrassMaterialId; // FIXME
-                    VoxelData->setMaterial(Index.X, Index.Y, Index.Z, DfaultGrassMaterialId);
+                    VoxelData->setMaterial(X, Y, Z, DfaultGrassMaterialId);
                 }
 
-                VoxelData->performSubstanceCacheLOD(Index.X, Index.Y, Index.Z, LOD);
+                VoxelData->performSubstanceCacheLOD(X, Y, Z, LOD);
 
                 if (Density == 0) {
                     zc++;
@@ -747,21 +973,6 @@ void UTerrainGeneratorComponent::GenerateZoneVolume(const TGenerateVdTempItm& It
     VoxelData->setCacheToValid();
 }
 
-ResultA UTerrainGeneratorComponent::A(const TVoxelIndex& ZoneIndex, const TVoxelIndex& VoxelIndex, TVoxelData* VoxelData, const TGenerateVdTempItm& Itm) const {
-    const FVector& LocalPos = VoxelData->voxelIndexToVector(VoxelIndex.X, VoxelIndex.Y, VoxelIndex.Z);
-    const FVector& WorldPos = LocalPos + VoxelData->getOrigin();
-    const float GroundLevel = Itm.ChunkData->GetHeightLevel(VoxelIndex.X, VoxelIndex.Y);
-    const float Density = ClcDensityByGroundLevel(WorldPos, GroundLevel);
-    const float Density2 = DensityFunctionExt(Density, std::make_tuple(ZoneIndex, VoxelIndex, WorldPos, LocalPos, Itm.ChunkData));
-    TMaterialId MaterialId = MaterialFuncion(ZoneIndex, WorldPos, GroundLevel);
-
-    MaterialId = MaterialFuncionExt(&Itm, MaterialId, WorldPos, VoxelIndex);
-
-    VoxelData->setDensityAndMaterial(VoxelIndex, Density2, MaterialId);
-    auto Result = std::make_tuple(LocalPos, WorldPos, Density2, MaterialId);
-    return Result;
-};
-
 float UTerrainGeneratorComponent::B(const TVoxelIndex& ZoneIndex, const TVoxelIndex& VoxelIndex, TVoxelData* VoxelData, TConstChunkData ChunkData) const {
     const FVector& LocalPos = VoxelData->voxelIndexToVector(VoxelIndex.X, VoxelIndex.Y, VoxelIndex.Z);
     const FVector& WorldPos = LocalPos + VoxelData->getOrigin();
@@ -779,9 +990,9 @@ void UTerrainGeneratorComponent::BatchGenerateComplexVd(TArray<TGenerateVdTempIt
     for (const auto& Itm : List) {
         const TVoxelIndex& ZoneIndex = Itm.ZoneIndex;
 
-        auto ZoneHandlerList = StructuresGenerator->StructureMap[ZoneIndex];
-        if (ZoneHandlerList.size() > 0) {
-            GenerateZoneVolumeWithFunction(Itm, ZoneHandlerList);
+        const auto It = StructuresGenerator->StructureMap.find(ZoneIndex);
+        if (It != StructuresGenerator->StructureMap.end() && It->second.size() > 0) {
+            GenerateZoneVolumeWithFunction(Itm, It->second);
             continue;
         }
 
@@ -848,6 +1059,11 @@ TZoneGenerationType UTerrainGeneratorComponent::ZoneGenType(const TVoxelIndex& Z
     return TZoneGenerationType::Other;
 }
 
+TZoneGenerationType UTerrainGeneratorComponent::PredictZoneGenType(const TVoxelIndex& ZoneIndex) {
+    const TChunkDataPtr ChunkData = GetChunkData(ZoneIndex.X, ZoneIndex.Y);
+    return ZoneGenType(ZoneIndex, ChunkData);
+}
+
 void UTerrainGeneratorComponent::GenerateSimpleVd(const TVoxelIndex& ZoneIndex, TVoxelData* VoxelData, const int Type, const TChunkDataPtr ChunkData) {
     if (Type == 0) {
         // air only
@@ -1132,8 +1348,8 @@ void UTerrainGeneratorComponent::GenerateNewFoliageLandscape(const TVoxelIndex&
             FVector LocalPos(X, Y, 0);
             V += LocalPos;
 
-            for (auto& Elem : GetController()->FoliageMap) {
-                FSandboxFoliage FoliageType = Elem.Value;
+            for (const auto& Elem : GetController()->FoliageMap) {
+                const FSandboxFoliage& FoliageType = Elem.Value;
 
                 if (FoliageType.Type == ESandboxFoliageType::Cave || FoliageType.Type == ESandboxFoliageType::Custom) {
                     continue;
@@ -1188,7 +1404,7 @@ void UTerrainGeneratorComponent::GenerateNewFoliageLandscape(const TVoxelIndex&
 
                                     bool bIsValidPosition = true;
                                     if (HasStructures(Index)) {
-                                        auto ZoneHandlerList = StructuresGenerator->StructureMap[Index];
+                                        const auto& ZoneHandlerList = StructuresGenerator->StructureMap.at(Index);
                                         if (ZoneHandlerList.size() > 0) {
                                             for (const auto& ZoneHandler : ZoneHandlerList) {
                                                 if (ZoneHandler.LandscapeFoliageFilter) {
@@ -0,0 +1,116 @@
+// Copyright blackw 2015-2020
+
+#include "Misc/AutomationTest.h"
+#include "SandboxTerrainController.h"
+#include "Core/VoxelDataInfo.hpp"
+#include "Core/TerrainData.hpp"
+#include <thread>
+#include <vector>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTerrainDataIndexHashTest, "UnrealSandboxTerrain.TerrainData.IndexHash", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+// symmetric indexes don't collide and zones around player are spread over all registry shards
+bool FTerrainDataIndexHashTest::RunTest(const FString& Parameters) {
+	std::unordered_set<uint64> HashSet;
+	int Num = 0;
+	for (int X = -8; X <= 8; X++) {
+		for (int Y = -8; Y <= 8; Y++) {
+			for (int Z = -8; Z <= 8; Z++) {
+				HashSet.insert(ClcVoxelIndexHash(X, Y, Z));
+				Num++;
+			}
+		}
+	}
+
+	TestEqual(TEXT("distinct hash"), (int)HashSet.size(), Num);
+
+	TestNotEqual(TEXT("(1, 2, 3) and (2, 1, 3)"), GetTypeHash(TVoxelIndex(1, 2, 3)), GetTypeHash(TVoxelIndex(2, 1, 3)));
+	TestNotEqual(TEXT("(1, 2, 3) and (3, 2, 1)"), GetTypeHash(TVoxelIndex(1, 2, 3)), GetTypeHash(TVoxelIndex(3, 2, 1)));
+	TestNotEqual(TEXT("(5, 5, 0) and (0, 0, 0)"), GetTypeHash(TVoxelIndex(5, 5, 0)), GetTypeHash(TVoxelIndex(0, 0, 0)));
+	TestNotEqual(TEXT("(-1, 1, 0) and (1, -1, 0)"), GetTypeHash(TVoxelIndex(-1, 1, 0)), GetTypeHash(TVoxelIndex(1, -1, 0)));
+
+	// active area of 16 x 16 x 4 zones
+	int ShardCount[TTerrainData::StorageShardNum] = { 0 };
+	int AreaNum = 0;
+	for (int X = -8; X < 8; X++) {
+		for (int Y = -8; Y < 8; Y++) {
+			for (int Z = -2; Z < 2; Z++) {
+				const int ShardIdx = TTerrainData::ClcStorageShardIndex(TVoxelIndex(X, Y, Z));
+				if (ShardIdx < 0 || ShardIdx >= TTerrainData::StorageShardNum) {
+					AddError(FString::Printf(TEXT("shard index %d out of range"), ShardIdx));
+					return false;
+				}
+
+				ShardCount[ShardIdx]++;
+				AreaNum++;
+			}
+		}
+	}
+
+	const int Mean = AreaNum / TTerrainData::StorageShardNum;
+	for (int ShardIdx = 0; ShardIdx < TTerrainData::StorageShardNum; ShardIdx++) {
+		if (ShardCount[ShardIdx] < Mean / 2 || ShardCount[ShardIdx] > Mean * 2) {
+			AddError(FString::Printf(TEXT("shard %d has %d zones, mean %d"), ShardIdx, ShardCount[ShardIdx], Mean));
+		}
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTerrainDataRegistryTest, "UnrealSandboxTerrain.TerrainData.Registry", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+// concurrent create of same zones gives one entry per zone
+bool FTerrainDataRegistryTest::RunTest(const FString& Parameters) {
+	TTerrainData TerrainData;
+
+	TArray<TVoxelIndex> IndexList;
+	for (int X = -4; X < 4; X++) {
+		for (int Y = -4; Y < 4; Y++) {
+			for (int Z = -2; Z < 2; Z++) {
+				IndexList.Add(TVoxelIndex(X, Y, Z));
+			}
+		}
+	}
+
+	TestNull(TEXT("not created zone"), TerrainData.FindVoxelDataInfo(IndexList[0]).get());
+
+	const int ThreadNum = 4;
+	std::vector<std::vector<TVoxelDataInfoPtr>> ResultList(ThreadNum);
+	std::vector<std::thread> ThreadList;
+	for (int T = 0; T < ThreadNum; T++) {
+		ThreadList.emplace_back([&, T]() {
+			// each thread goes in other order
+			for (int I = 0; I < IndexList.Num(); I++) {
+				const int Idx = (I * (T * 2 + 1)) % IndexList.Num();
+				ResultList[T].push_back(TerrainData.GetVoxelDataInfo(IndexList[Idx]));
+			}
+		});
+	}
+
+	for (auto& Thread : ThreadList) {
+		Thread.join();
+	}
+
+	for (int T = 0; T < ThreadNum; T++) {
+		for (int I = 0; I < IndexList.Num(); I++) {
+			const int Idx = (I * (T * 2 + 1)) % IndexList.Num();
+			if (ResultList[T][I] != TerrainData.FindVoxelDataInfo(IndexList[Idx])) {
+				AddError(FString::Printf(TEXT("thread %d: other entry for zone %d %d %d"), T, IndexList[Idx].X, IndexList[Idx].Y, IndexList[Idx].Z));
+			}
+		}
+	}
+
+	int VisitCount = 0;
+	TerrainData.ForEachVoxelDataInfo([&](const TVoxelIndex& Index, const TVoxelDataInfoPtr& VdInfoPtr) {
+		VisitCount++;
+	});
+
+	TestEqual(TEXT("entry count"), VisitCount, IndexList.Num());
+
+	TerrainData.Clean();
+	return true;
+}
+
+#endif
@@ -0,0 +1,78 @@
+// Copyright blackw 2015-2020
+
+#include "Misc/AutomationTest.h"
+#include "TerrainGeneratorComponent.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// same as material layer lookup before binary search
+static const FTerrainUndergroundLayer* FindMaterialLayerLinear(const TArray<FTerrainUndergroundLayer>& LayerList, float Z, float RealGroundLevel) {
+	for (int Idx = 0; Idx < LayerList.Num() - 1; Idx++) {
+		const FTerrainUndergroundLayer& Layer = LayerList[Idx];
+		if (Z <= RealGroundLevel - Layer.StartDepth && Z > RealGroundLevel - LayerList[Idx + 1].StartDepth) {
+			return &Layer;
+		}
+	}
+
+	return nullptr;
+}
+
+static void AddLayer(TArray<FTerrainUndergroundLayer>& LayerList, int32 MatId, float StartDepth) {
+	FTerrainUndergroundLayer Layer;
+	Layer.MatId = MatId;
+	Layer.StartDepth = StartDepth;
+	LayerList.Add(Layer);
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTerrainGeneratorMaterialLayerTest, "UnrealSandboxTerrain.Generator.MaterialLayer", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+// binary search gives the same layer as linear scan for sorted, equal depth and unsorted layers
+bool FTerrainGeneratorMaterialLayerTest::RunTest(const FString& Parameters) {
+	UTerrainGeneratorComponent* Generator = NewObject<UTerrainGeneratorComponent>();
+
+	TArray<TArray<FTerrainUndergroundLayer>> CaseList;
+
+	TArray<FTerrainUndergroundLayer>& Sorted = CaseList.AddDefaulted_GetRef();
+	AddLayer(Sorted, 1, 0);
+	AddLayer(Sorted, 2, 100);
+	AddLayer(Sorted, 3, 250);
+	AddLayer(Sorted, 4, 1000);
+
+	TArray<FTerrainUndergroundLayer>& EqualDepth = CaseList.AddDefaulted_GetRef();
+	AddLayer(EqualDepth, 1, 0);
+	AddLayer(EqualDepth, 2, 300);
+	AddLayer(EqualDepth, 3, 300);
+	AddLayer(EqualDepth, 4, 500);
+
+	TArray<FTerrainUndergroundLayer>& Unsorted = CaseList.AddDefaulted_GetRef();
+	AddLayer(Unsorted, 1, 0);
+	AddLayer(Unsorted, 2, 400);
+	AddLayer(Unsorted, 3, 200);
+
+	TArray<FTerrainUndergroundLayer>& Single = CaseList.AddDefaulted_GetRef();
+	AddLayer(Single, 1, 0);
+
+	const float GroundLevel = 500.f;
+
+	for (int CaseIdx = 0; CaseIdx < CaseList.Num(); CaseIdx++) {
+		// terminator as in BeginPlay
+		Generator->UndergroundLayersTmp = CaseList[CaseIdx];
+		AddLayer(Generator->UndergroundLayersTmp, 0, MAX_FLT);
+		Generator->PrepareMaterialLayers();
+
+		TestEqual(FString::Printf(TEXT("case %d sorted flag"), CaseIdx), Generator->bUndergroundLayersSorted, CaseIdx != 2);
+
+		// layer borders and points between
+		for (float Z = GroundLevel + 50.f; Z > GroundLevel - 1500.f; Z -= 12.5f) {
+			const FTerrainUndergroundLayer* Expected = FindMaterialLayerLinear(Generator->UndergroundLayersTmp, Z, GroundLevel);
+			const FTerrainUndergroundLayer* Layer = Generator->GetMaterialLayer(Z, GroundLevel);
+			if (Layer != Expected) {
+				AddError(FString::Printf(TEXT("case %d, Z = %f: layer %d, expected %d"), CaseIdx, Z, Layer ? Layer->MatId : -1, Expected ? Expected->MatId : -1));
+			}
+		}
+	}
+
+	return true;
+}
+
+#endif
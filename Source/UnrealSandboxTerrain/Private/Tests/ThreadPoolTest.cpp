@@ -0,0 +1,82 @@
+// Copyright blackw 2015-2020
+
+#include "Misc/AutomationTest.h"
+#include "Core/ThreadPool.hpp"
+#include <condition_variable>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+static bool WaitFor(const std::atomic<int>& Counter, const int Value) {
+	const double Start = FPlatformTime::Seconds();
+	while (Counter.load() < Value) {
+		if (FPlatformTime::Seconds() - Start > 5) {
+			return false;
+		}
+
+		FPlatformProcess::Sleep(0.001f);
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FThreadPoolKeyedTaskTest, "UnrealSandboxTerrain.ThreadPool.KeyedTask", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+// queued task with same key is replaced in place, started task is not affected
+bool FThreadPoolKeyedTaskTest::RunTest(const FString& Parameters) {
+	TThreadPool Pool(1);
+
+	std::atomic<int> StartedCount { 0 };
+	std::atomic<bool> bRelease { false };
+	std::atomic<int> DoneCount { 0 };
+	std::vector<char> RunOrder;
+
+	auto MakeTask = [&](const char Name) {
+		return [&, Name]() {
+			RunOrder.push_back(Name);
+			DoneCount++;
+		};
+	};
+
+	// single worker is busy, next tasks stay in queue
+	Pool.addTask([&]() {
+		StartedCount++;
+		while (!bRelease) {
+			FPlatformProcess::Sleep(0.001f);
+		}
+	}, false, 7);
+
+	if (!WaitFor(StartedCount, 1)) {
+		AddError(TEXT("blocking task is not started"));
+		bRelease = true;
+		return false;
+	}
+
+	Pool.addTask(MakeTask('A'), false, 7); // started task with key 7 is not replaced
+	Pool.addTask(MakeTask('B'), false, 0);
+	Pool.addTask(MakeTask('C'), false, 7); // replaces A, keeps its place before B
+	Pool.addTask(MakeTask('D'), true, 0);
+
+	TestEqual(TEXT("queued tasks"), Pool.size(), 3);
+
+	bRelease = true;
+	if (!WaitFor(DoneCount, 3)) {
+		AddError(TEXT("queued tasks are not finished"));
+		return false;
+	}
+
+	FPlatformProcess::Sleep(0.01f);
+	TestEqual(TEXT("done tasks"), DoneCount.load(), 3);
+	TestEqual(TEXT("run order"), FString(RunOrder.size(), RunOrder.data()), FString(TEXT("DCB")));
+
+	// key is free after task is started
+	Pool.addTask(MakeTask('E'), false, 7);
+	if (!WaitFor(DoneCount, 4)) {
+		AddError(TEXT("task with reused key is not finished"));
+		return false;
+	}
+
+	TestEqual(TEXT("queued tasks after run"), Pool.size(), 0);
+	return true;
+}
+
+#endif
@@ -0,0 +1,92 @@
+// Copyright blackw 2015-2020
+
+#include "Misc/AutomationTest.h"
+#include "VoxelMeshComponent.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+static void AddTriangles(FProcMeshSection& Section, const int32 Num) {
+	for (int32 TriIdx = 0; TriIdx < Num; TriIdx++) {
+		const uint32 Base = Section.ProcVertexBuffer.Num();
+		const FVector Offset(TriIdx * 100.f, 0, 0);
+		Section.AddVertex(TMeshVertex{ Offset + FVector(0, 0, 0), FVector(0, 0, 1), 0 });
+		Section.AddVertex(TMeshVertex{ Offset + FVector(100, 0, 0), FVector(0, 0, 1), 0 });
+		Section.AddVertex(TMeshVertex{ Offset + FVector(0, 100, 0), FVector(0, 0, 1), 0 });
+		Section.ProcIndexBuffer.Add(Base + 0);
+		Section.ProcIndexBuffer.Add(Base + 1);
+		Section.ProcIndexBuffer.Add(Base + 2);
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelMeshCollisionFaceMaterialTest, "UnrealSandboxTerrain.Collision.FaceMaterial", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+// face range table gives the same material as per face list in order of GetPhysicsTriMeshData
+bool FVoxelMeshCollisionFaceMaterialTest::RunTest(const FString& Parameters) {
+	TMeshDataPtr MeshDataPtr = std::make_shared<TMeshData>();
+	TMeshContainer& MeshContainer = MeshDataPtr->MeshSectionLodArray[0].RegularMeshContainer;
+
+	TMeshMaterialSection& Section3 = MeshContainer.MaterialSectionMap.Add(3);
+	Section3.MaterialId = 3;
+	AddTriangles(Section3.MaterialMesh, 2);
+
+	TMeshMaterialSection& SectionEmpty = MeshContainer.MaterialSectionMap.Add(4);
+	SectionEmpty.MaterialId = 4;
+
+	TMeshMaterialSection& Section8 = MeshContainer.MaterialSectionMap.Add(8);
+	Section8.MaterialId = 8;
+	AddTriangles(Section8.MaterialMesh, 1);
+
+	// transition face gets first material of set, range is merged with previous one of same material
+	TMeshMaterialTransitionSection& Transition = MeshContainer.MaterialTransitionSectionMap.Add(1);
+	Transition.MaterialIdSet = { 8, 11 };
+	AddTriangles(Transition.MaterialMesh, 2);
+
+	TMeshMaterialTransitionSection& Transition2 = MeshContainer.MaterialTransitionSectionMap.Add(2);
+	Transition2.MaterialIdSet = { 2, 3 };
+	AddTriangles(Transition2.MaterialMesh, 3);
+
+	// per face reference
+	TArray<TMaterialId> FaceMaterialList;
+	for (const auto& Elem : MeshContainer.MaterialSectionMap) {
+		for (int32 Idx = 0; Idx < Elem.Value.MaterialMesh.ProcIndexBuffer.Num() / 3; Idx++) {
+			FaceMaterialList.Add(Elem.Value.MaterialId);
+		}
+	}
+
+	for (const auto& Elem : MeshContainer.MaterialTransitionSectionMap) {
+		for (int32 Idx = 0; Idx < Elem.Value.MaterialMesh.ProcIndexBuffer.Num() / 3; Idx++) {
+			FaceMaterialList.Add(*Elem.Value.MaterialIdSet.begin());
+		}
+	}
+
+	UVoxelMeshComponent* MeshComponent = NewObject<UVoxelMeshComponent>();
+	MeshComponent->CollisionMeshDataPtr = MeshDataPtr;
+	MeshComponent->CollisionLodIndex = 0;
+	MeshComponent->BuildCollisionFaceMaterialTable();
+
+	TestEqual(TEXT("face ranges"), MeshComponent->CollisionFaceRangeEnd.Num(), 3);
+	TestEqual(TEXT("range materials"), MeshComponent->CollisionFaceRangeMaterial.Num(), 3);
+
+	TArray<int32> FaceIndexArray;
+	for (int32 FaceIdx = 0; FaceIdx < FaceMaterialList.Num(); FaceIdx++) {
+		TestEqual(FString::Printf(TEXT("face %d"), FaceIdx), (int32)MeshComponent->GetMaterialIdFromCollisionFaceIndex(FaceIdx), (int32)FaceMaterialList[FaceIdx]);
+		FaceIndexArray.Add(FaceIdx);
+	}
+
+	// unknown face gets 0
+	TestEqual(TEXT("negative face"), (int32)MeshComponent->GetMaterialIdFromCollisionFaceIndex(-1), 0);
+	TestEqual(TEXT("face after last"), (int32)MeshComponent->GetMaterialIdFromCollisionFaceIndex(FaceMaterialList.Num()), 0);
+
+	TArray<TMaterialId> MaterialIdArray;
+	MeshComponent->GetMaterialIdsFromCollisionFaceIndices(FaceIndexArray, MaterialIdArray);
+	TestTrue(TEXT("many faces at once"), MaterialIdArray == FaceMaterialList);
+
+	// no collision
+	MeshComponent->CollisionLodIndex = -1;
+	MeshComponent->BuildCollisionFaceMaterialTable();
+	TestEqual(TEXT("no collision face"), (int32)MeshComponent->GetMaterialIdFromCollisionFaceIndex(0), 0);
+
+	return true;
+}
+
+#endif
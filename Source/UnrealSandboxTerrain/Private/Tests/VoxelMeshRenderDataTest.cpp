@@ -0,0 +1,106 @@
+// Copyright blackw 2015-2020
+
+#include "Misc/AutomationTest.h"
+#include "VoxelMeshData.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+static void AddTriangle(FProcMeshSection& Section, const FVector& Offset, const int32 MatIdx0, const int32 MatIdx1, const int32 MatIdx2) {
+	const uint32 Base = Section.ProcVertexBuffer.Num();
+	Section.AddVertex(TMeshVertex{ Offset + FVector(0, 0, 0), FVector(0, 0, 1), MatIdx0 });
+	Section.AddVertex(TMeshVertex{ Offset + FVector(100, 0, 0), FVector(0, 1, 0), MatIdx1 });
+	Section.AddVertex(TMeshVertex{ Offset + FVector(0, 100, 0), FVector(-1, 0, 0), MatIdx2 });
+	Section.ProcIndexBuffer.Add(Base + 0);
+	Section.ProcIndexBuffer.Add(Base + 1);
+	Section.ProcIndexBuffer.Add(Base + 2);
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelMeshPackedVertexTest, "UnrealSandboxTerrain.RenderData.PackedVertex", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+// render section has layout of local vertex factory streams: float3 position, 2 packed normals, half2 uv, color
+bool FVoxelMeshPackedVertexTest::RunTest(const FString& Parameters) {
+	const SIZE_T VertexSize = sizeof(TPackedVertexVector) + 2 * sizeof(FPackedNormal) + sizeof(FVector2DHalf) + sizeof(FColor);
+	TestEqual(TEXT("bytes per vertex"), (int32)VertexSize, 28);
+
+	FProcMeshSection EmptySection;
+	TestNull(TEXT("empty section"), BuildMeshRenderSection(EmptySection).get());
+
+	FProcMeshSection Section;
+	AddTriangle(Section, FVector(10, 20, 30), 0, 1, 5);
+
+	TMeshRenderSectionPtr RenderSection = BuildMeshRenderSection(Section);
+	if (!TestNotNull(TEXT("render section"), RenderSection.get())) {
+		return false;
+	}
+
+	TestEqual(TEXT("vertices"), RenderSection->NumVertices(), 3);
+	TestEqual(TEXT("tangents"), RenderSection->Tangents.Num(), 6);
+	TestEqual(TEXT("colors"), RenderSection->Colors.Num(), 3);
+	TestEqual(TEXT("one zero uv"), RenderSection->NumTexCoords(), 1);
+	TestEqual(TEXT("no uv data"), RenderSection->TexCoords.Num(), 0);
+	TestTrue(TEXT("indices"), RenderSection->Indices == Section.ProcIndexBuffer);
+
+	// transition material weight by vertex material index, unknown index has no weight
+	const FColor ExpectedColor[3] = { FColor(255, 0, 0, 0), FColor(0, 255, 0, 0), FColor(0, 0, 0, 0) };
+
+	for (int32 VertIdx = 0; VertIdx < 3; VertIdx++) {
+		const TMeshVertex& ProcVert = Section.ProcVertexBuffer[VertIdx];
+		TestTrue(FString::Printf(TEXT("position %d"), VertIdx), FVector(RenderSection->Positions[VertIdx]).Equals(ProcVert.Pos));
+		TestTrue(FString::Printf(TEXT("tangent x %d"), VertIdx), FVector(RenderSection->Tangents[VertIdx * 2].ToFVector()).Equals(FVector(1, 0, 0), 0.02f));
+		TestTrue(FString::Printf(TEXT("tangent z %d"), VertIdx), FVector(RenderSection->Tangents[VertIdx * 2 + 1].ToFVector()).Equals(ProcVert.Normal, 0.02f));
+		TestEqual(FString::Printf(TEXT("color %d"), VertIdx), RenderSection->Colors[VertIdx], ExpectedColor[VertIdx]);
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelMeshMergedSectionTest, "UnrealSandboxTerrain.RenderData.MergedSection", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+// merged section keeps material ids in two half uv per vertex, regular material has full first weight
+bool FVoxelMeshMergedSectionTest::RunTest(const FString& Parameters) {
+	TMeshContainer MeshContainer;
+
+	TMeshMaterialSection& RegularSection = MeshContainer.MaterialSectionMap.Add(5);
+	RegularSection.MaterialId = 5;
+	AddTriangle(RegularSection.MaterialMesh, FVector(0, 0, 0), 2, 2, 2);
+
+	TMeshMaterialTransitionSection& TransitionSection = MeshContainer.MaterialTransitionSectionMap.Add(1);
+	TransitionSection.MaterialIdSet = { 2, 7, 9 };
+	AddTriangle(TransitionSection.MaterialMesh, FVector(0, 0, 100), 0, 1, 2);
+
+	TMeshRenderSectionPtr RenderSection = BuildMergedMeshRenderSection(MeshContainer);
+	if (!TestNotNull(TEXT("merged section"), RenderSection.get())) {
+		return false;
+	}
+
+	TestEqual(TEXT("vertices"), RenderSection->NumVertices(), 6);
+	TestEqual(TEXT("uv per vertex"), RenderSection->NumTexCoords(), 2);
+	TestEqual(TEXT("indices"), RenderSection->Indices.Num(), 6);
+	TestEqual(TEXT("transition index base"), (int32)RenderSection->Indices[3], 3);
+
+	const float ExpectedMaterial[6][3] = { { 5, 5, 5 }, { 5, 5, 5 }, { 5, 5, 5 }, { 2, 7, 9 }, { 2, 7, 9 }, { 2, 7, 9 } };
+	const FColor ExpectedColor[6] = { FColor(255, 0, 0, 0), FColor(255, 0, 0, 0), FColor(255, 0, 0, 0), FColor(255, 0, 0, 0), FColor(0, 255, 0, 0), FColor(0, 0, 255, 0) };
+
+	for (int32 VertIdx = 0; VertIdx < 6; VertIdx++) {
+		const FVector2DHalf& UV0 = RenderSection->TexCoords[VertIdx * 2];
+		const FVector2DHalf& UV1 = RenderSection->TexCoords[VertIdx * 2 + 1];
+		TestEqual(FString::Printf(TEXT("material 0 of %d"), VertIdx), (float)UV0.X, ExpectedMaterial[VertIdx][0]);
+		TestEqual(FString::Printf(TEXT("material 1 of %d"), VertIdx), (float)UV0.Y, ExpectedMaterial[VertIdx][1]);
+		TestEqual(FString::Printf(TEXT("material 2 of %d"), VertIdx), (float)UV1.X, ExpectedMaterial[VertIdx][2]);
+		TestEqual(FString::Printf(TEXT("color %d"), VertIdx), RenderSection->Colors[VertIdx], ExpectedColor[VertIdx]);
+	}
+
+	// batch appends sections moved by zone offset
+	TMeshRenderSection Batch;
+	AppendMeshRenderSection(Batch, *RenderSection, TPackedVertexVector(1000.f, 0.f, 0.f));
+	AppendMeshRenderSection(Batch, *RenderSection, TPackedVertexVector(0.f, 1000.f, 0.f));
+
+	TestEqual(TEXT("batch vertices"), Batch.NumVertices(), 12);
+	TestEqual(TEXT("batch uv per vertex"), Batch.NumTexCoords(), 2);
+	TestEqual(TEXT("batch second index base"), (int32)Batch.Indices[6], 6);
+	TestTrue(TEXT("batch second offset"), FVector(Batch.Positions[6]).Equals(FVector(RenderSection->Positions[0]) + FVector(0, 1000, 0)));
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,69 @@
+// Copyright blackw 2015-2020
+
+#include "FarTerrainComponent.h"
+#include "SandboxTerrainController.h"
+#include "Engine.h"
+#include "Core/VoxelMeshProxy.hpp"
+
+
+// ================================================================================================================================================
+// UFarTerrainComponent
+// ================================================================================================================================================
+
+UFarTerrainComponent::UFarTerrainComponent(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer) {
+	FarTerrainMaterial = nullptr;
+	CastShadow = false;
+	SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	SetCanEverAffectNavigation(false);
+}
+
+FPrimitiveSceneProxy* UFarTerrainComponent::CreateSceneProxy() {
+	if (!MeshDataPtr || MeshDataPtr->Mesh.ProcIndexBuffer.Num() == 0) {
+		return nullptr;
+	}
+
+	// mesh data is kept: shared with controller cache and used again if render state is recreated
+	return new FFarTerrainSceneProxy(this);
+}
+
+int32 UFarTerrainComponent::GetNumMaterials() const {
+	return FarTerrainMaterial ? 1 : 0;
+}
+
+void UFarTerrainComponent::GetUsedMaterials(TArray<UMaterialInterface*>& OutMaterials, bool bGetDebugMaterials) const {
+	OutMaterials.Add(UMaterial::GetDefaultMaterial(MD_Surface));
+	if (FarTerrainMaterial) {
+		OutMaterials.Add(FarTerrainMaterial);
+	}
+}
+
+void UFarTerrainComponent::SetFarTerrainMeshData(TFarTerrainMeshDataPtr NewMeshDataPtr, UMaterialInterface* Material) {
+	MeshDataPtr = NewMeshDataPtr;
+	FarTerrainMaterial = Material;
+	UpdateBounds();
+	MarkRenderTransformDirty();
+	MarkRenderStateDirty();
+}
+
+void UFarTerrainComponent::SetCoveredCells(const TBitArray<>& NewCoveredCellMask) {
+	if (CoveredCellMask == NewCoveredCellMask) {
+		return;
+	}
+
+	CoveredCellMask = NewCoveredCellMask;
+
+	if (SceneProxy) {
+		FFarTerrainSceneProxy* FarTerrainSceneProxy = (FFarTerrainSceneProxy*)SceneProxy;
+		ENQUEUE_RENDER_COMMAND(FFarTerrainSetCoveredCells)([FarTerrainSceneProxy, NewCoveredCellMask](FRHICommandListImmediate& RHICmdList) {
+			FarTerrainSceneProxy->SetCoveredCells_RenderThread(NewCoveredCellMask);
+		});
+	}
+}
+
+FBoxSphereBounds UFarTerrainComponent::CalcBounds(const FTransform& LocalToWorld) const {
+	if (MeshDataPtr && MeshDataPtr->Mesh.SectionLocalBox.IsValid) {
+		return FBoxSphereBounds(MeshDataPtr->Mesh.SectionLocalBox).TransformBy(LocalToWorld);
+	}
+
+	return FBoxSphereBounds(LocalToWorld.GetLocation(), FVector(0), 0);
+}
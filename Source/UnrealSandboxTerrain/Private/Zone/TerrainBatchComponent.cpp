@@ -0,0 +1,55 @@
+// Copyright blackw 2015-2020
+
+#include "TerrainBatchComponent.h"
+#include "SandboxTerrainController.h"
+#include "Engine.h"
+#include "Core/VoxelMeshProxy.hpp"
+
+
+// ================================================================================================================================================
+// UTerrainBatchComponent
+// ================================================================================================================================================
+
+UTerrainBatchComponent::UTerrainBatchComponent(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer) {
+	SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	SetCanEverAffectNavigation(false);
+	bCastShadowAsTwoSided = true;
+}
+
+FPrimitiveSceneProxy* UTerrainBatchComponent::CreateSceneProxy() {
+	if (!MeshDataPtr || MeshDataPtr->SectionArray.Num() == 0) {
+		return nullptr;
+	}
+
+	// mesh data is kept: used again if render state is recreated
+	return new FTerrainBatchSceneProxy(this);
+}
+
+int32 UTerrainBatchComponent::GetNumMaterials() const {
+	return SectionMaterials.Num();
+}
+
+void UTerrainBatchComponent::GetUsedMaterials(TArray<UMaterialInterface*>& OutMaterials, bool bGetDebugMaterials) const {
+	OutMaterials.Add(UMaterial::GetDefaultMaterial(MD_Surface));
+	for (UMaterialInterface* Material : SectionMaterials) {
+		if (Material) {
+			OutMaterials.Add(Material);
+		}
+	}
+}
+
+void UTerrainBatchComponent::SetBatchMeshData(TZoneBatchMeshDataPtr NewMeshDataPtr, const TArray<UMaterialInterface*>& Materials) {
+	MeshDataPtr = NewMeshDataPtr;
+	SectionMaterials = Materials;
+	UpdateBounds();
+	MarkRenderTransformDirty();
+	MarkRenderStateDirty();
+}
+
+FBoxSphereBounds UTerrainBatchComponent::CalcBounds(const FTransform& LocalToWorld) const {
+	if (MeshDataPtr && MeshDataPtr->LocalBox.IsValid) {
+		return FBoxSphereBounds(MeshDataPtr->LocalBox).TransformBy(LocalToWorld);
+	}
+
+	return FBoxSphereBounds(LocalToWorld.GetLocation(), FVector(0), 0);
+}
@@ -0,0 +1,131 @@
+// Copyright blackw 2015-2020
+
+#include "TerrainCollisionChunkComponent.h"
+#include "VoxelMeshComponent.h"
+#include "SandboxTerrainController.h"
+#include "Engine.h"
+#include "PhysicsEngine/PhysicsSettings.h"
+#include "PhysicsEngine/BodySetup.h"
+
+
+// ================================================================================================================================================
+// UTerrainCollisionChunkComponent
+// ================================================================================================================================================
+
+UTerrainCollisionChunkComponent::UTerrainCollisionChunkComponent(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer) {
+	ChunkBodySetup = nullptr;
+	LocalBox.Init();
+	SetCastShadow(false);
+}
+
+void UTerrainCollisionChunkComponent::SetChunkData(const TCollisionChunkData& NewChunkData) {
+	ChunkData = NewChunkData;
+
+	LocalBox.Init();
+	for (const auto& Vertex : ChunkData.Vertices) {
+		LocalBox += FVector(Vertex);
+	}
+
+	UpdateBounds();
+	UpdateCollision();
+}
+
+uint32 UTerrainCollisionChunkComponent::GetChunkHash() const {
+	return ChunkData.Hash;
+}
+
+TMaterialId UTerrainCollisionChunkComponent::GetMaterialIdFromCollisionFaceIndex(int32 FaceIndex) const {
+	return ChunkData.MaterialIds.IsValidIndex(FaceIndex) ? ChunkData.MaterialIds[FaceIndex] : 0;
+}
+
+void UTerrainCollisionChunkComponent::GetMaterialIdsFromCollisionFaceIndices(const TArray<int32>& FaceIndexArray, TArray<TMaterialId>& OutMaterialIdArray) const {
+	OutMaterialIdArray.SetNumUninitialized(FaceIndexArray.Num());
+	for (int32 Idx = 0; Idx < FaceIndexArray.Num(); Idx++) {
+		OutMaterialIdArray[Idx] = GetMaterialIdFromCollisionFaceIndex(FaceIndexArray[Idx]);
+	}
+}
+
+FBoxSphereBounds UTerrainCollisionChunkComponent::CalcBounds(const FTransform& LocalToWorld) const {
+	if (LocalBox.IsValid) {
+		return FBoxSphereBounds(LocalBox).TransformBy(LocalToWorld);
+	}
+
+	return FBoxSphereBounds(LocalToWorld.GetLocation(), FVector(0), 0);
+}
+
+bool UTerrainCollisionChunkComponent::GetPhysicsTriMeshData(struct FTriMeshCollisionData* CollisionData, bool InUseAllTriData) {
+	if (ChunkData.Indices.Num() == 0) {
+		return false;
+	}
+
+	if (UPhysicsSettings::Get()->bSupportUVFromHitResults) {
+		CollisionData->UVs.AddZeroed(1); // only one UV channel
+	}
+
+	CollisionData->Vertices = ChunkData.Vertices;
+	CollisionData->Indices = ChunkData.Indices;
+
+	CollisionData->MaterialIndices.Reserve(ChunkData.MaterialIds.Num());
+	for (TMaterialId MatId : ChunkData.MaterialIds) {
+		CollisionData->MaterialIndices.Add(MatId);
+	}
+
+	CollisionData->bFlipNormals = true;
+	CollisionData->bDeformableMesh = true;
+	CollisionData->bFastCook = true;
+	return true;
+}
+
+bool UTerrainCollisionChunkComponent::ContainsPhysicsTriMeshData(bool InUseAllTriData) const {
+	return ChunkData.Indices.Num() > 0;
+}
+
+UBodySetup* UTerrainCollisionChunkComponent::GetBodySetup() {
+	if (!ChunkBodySetup) {
+		ChunkBodySetup = CreateBodySetupHelper();
+	}
+
+	return ChunkBodySetup;
+}
+
+UBodySetup* UTerrainCollisionChunkComponent::CreateBodySetupHelper() {
+	UBodySetup* NewBodySetup = NewObject<UBodySetup>(this, NAME_None, (IsTemplate() ? RF_Public : RF_NoFlags));
+	NewBodySetup->BodySetupGuid = FGuid::NewGuid();
+	NewBodySetup->bGenerateMirroredCollision = false;
+	NewBodySetup->bDoubleSidedGeometry = true;
+	NewBodySetup->CollisionTraceFlag = CTF_UseComplexAsSimple;
+	return NewBodySetup;
+}
+
+void UTerrainCollisionChunkComponent::FinishPhysicsAsyncCook(bool bSuccess, UBodySetup* FinishedBodySetup) {
+	int32 FoundIdx;
+	if (AsyncBodySetupQueue.Find(FinishedBodySetup, FoundIdx)) {
+		if (bSuccess) {
+			// newer than current body: use it and drop older requests
+			ChunkBodySetup = FinishedBodySetup;
+			RecreatePhysicsState();
+			AsyncBodySetupQueue.RemoveAt(0, FoundIdx + 1);
+		} else {
+			AsyncBodySetupQueue.RemoveAt(FoundIdx);
+		}
+	}
+
+	UpdateNavigationData();
+
+	UVoxelMeshComponent* MeshComponent = Cast<UVoxelMeshComponent>(GetAttachParent());
+	ASandboxTerrainController* TerrainController = Cast<ASandboxTerrainController>(GetAttachmentRootActor());
+	if (TerrainController && MeshComponent) {
+		TerrainController->OnFinishAsyncPhysicsCook(MeshComponent->ZoneIndex);
+	}
+}
+
+void UTerrainCollisionChunkComponent::UpdateCollision() {
+	// only this chunk is aborted, other chunks of zone keep cooking
+	for (UBodySetup* OldBody : AsyncBodySetupQueue) {
+		OldBody->AbortPhysicsMeshAsyncCreation();
+	}
+
+	AsyncBodySetupQueue.Add(CreateBodySetupHelper());
+	UBodySetup* UseBodySetup = AsyncBodySetupQueue.Last();
+	UseBodySetup->CreatePhysicsMeshesAsync(FOnAsyncPhysicsCookFinished::CreateUObject(this, &UTerrainCollisionChunkComponent::FinishPhysicsAsyncCook, UseBodySetup));
+}
@@ -23,8 +23,65 @@ void UTerrainZoneComponent::FinishDestroy() {
 }
 
 void UTerrainZoneComponent::DestroyComponent(bool bPromoteChildren) {
+	for (auto& Elem : IdleInstancedMeshMap) {
+		Elem.Value->DestroyComponent();
+	}
+
+	IdleInstancedMeshMap.Empty();
+
 	Super::DestroyComponent(bPromoteChildren);
-	zone_counter--;
+	if (!bPooled) {
+		zone_counter--;
+	}
+}
+
+void UTerrainZoneComponent::ResetForPool() {
+	{
+		const std::lock_guard<std::mutex> lock(InstancedMeshMutex);
+		for (auto& Elem : InstancedMeshMap) {
+			UTerrainInstancedStaticMesh* InstancedStaticMeshComponent = Elem.Value;
+			InstancedStaticMeshComponent->ClearInstances();
+			InstancedStaticMeshComponent->SetVisibility(false);
+			InstancedStaticMeshComponent->DetachFromComponent(FDetachmentTransformRules::KeepRelativeTransform);
+			IdleInstancedMeshMap.Add(Elem.Key, InstancedStaticMeshComponent);
+		}
+
+		InstancedMeshMap.Empty();
+	}
+
+	// anything else attached by game code
+	TArray<USceneComponent*> ChildList;
+	GetChildrenComponents(true, ChildList);
+	for (USceneComponent* Child : ChildList) {
+		// collision chunks of main mesh are reused with it
+		if (Child != MainTerrainMesh && Child->GetAttachParent() != MainTerrainMesh) {
+			Child->DestroyComponent(true);
+		}
+	}
+
+	{
+		const std::lock_guard<std::mutex> lock(TerrainMeshMutex);
+		MeshDataTimeStamp = 0;
+		VStamp = 0;
+		MainTerrainMesh->ClearMeshData();
+		MainTerrainMesh->SetBatched(false);
+		MainTerrainMesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		MainTerrainMesh->SyncCollisionChunkSettings();
+	}
+
+	SetVisibility(false, true);
+	bPooled = true;
+}
+
+void UTerrainZoneComponent::RestoreFromPool() {
+	SetVisibility(true, true);
+	MainTerrainMesh->SetCollisionProfileName(TEXT("InvisibleWall"));
+	MainTerrainMesh->SyncCollisionChunkSettings();
+	bPooled = false;
+}
+
+bool UTerrainZoneComponent::IsPooled() const {
+	return bPooled;
 }
 
 #define TRACE_APPLY_MESH 0
@@ -55,8 +112,8 @@ void UTerrainZoneComponent::ApplyTerrainMesh(TMeshDataPtr MeshDataPtr, bool bIgn
 	MeshDataTimeStamp = MeshDataPtr->TimeStamp;
 	VStamp = MeshDataPtr->VStamp;
 
-	for (auto TTT : MeshDataPtr->MeshSectionLodArray) {
-		for (auto P : TTT.DebugPointList) {
+	for (const auto& TTT : MeshDataPtr->MeshSectionLodArray) {
+		for (const auto& P : TTT.DebugPointList) {
 			DrawDebugPoint(GetWorld(), P, 5.f, FColor(255, 255, 255, 0), true);
 		}
 	}
@@ -72,6 +129,7 @@ void UTerrainZoneComponent::ApplyTerrainMesh(TMeshDataPtr MeshDataPtr, bool bIgn
 	MainTerrainMesh->bCastHiddenShadow = true;
 	MainTerrainMesh->bAffectDistanceFieldLighting = false;
 	MainTerrainMesh->SetCollisionProfileName(TEXT("BlockAll"));
+	MainTerrainMesh->SyncCollisionChunkSettings();
 
 
 #if TRACE_APPLY_MESH == 1 
@@ -212,6 +270,16 @@ void UTerrainZoneComponent::SpawnInstancedMesh(const FTerrainInstancedMeshType&
 		InstancedStaticMeshComponent = InstancedMeshMap[MeshCode];
 	}
 
+	if (InstancedStaticMeshComponent == nullptr) {
+		UTerrainInstancedStaticMesh* IdleComponent = nullptr;
+		if (IdleInstancedMeshMap.RemoveAndCopyValue(MeshCode, IdleComponent)) {
+			InstancedStaticMeshComponent = IdleComponent;
+			InstancedStaticMeshComponent->AttachToComponent(this, FAttachmentTransformRules::KeepRelativeTransform, NAME_None);
+			InstancedStaticMeshComponent->SetVisibility(true);
+			InstancedMeshMap.Add(MeshCode, InstancedStaticMeshComponent);
+		}
+	}
+
 	bool bIsFoliage = GetTerrainController()->FoliageMap.Contains(MeshType.MeshTypeId);
 	if (InstancedStaticMeshComponent == nullptr) {
 		FString InstancedStaticMeshCompName = FString::Printf(TEXT("InstancedStaticMesh - [%d, %d]-> [%.0f, %.0f, %.0f]"), MeshType.MeshTypeId, MeshType.MeshVariantId, GetComponentLocation().X, GetComponentLocation().Y, GetComponentLocation().Z);
@@ -1,11 +1,13 @@
 // Copyright blackw 2015-2020
 
 #include "VoxelMeshComponent.h"
+#include "TerrainCollisionChunkComponent.h"
 #include "SandboxTerrainController.h"
 #include "Engine.h"
 #include "PhysicsEngine/PhysicsSettings.h"
 #include "PhysicsEngine/BodySetup.h"
 #include "Runtime/Launch/Resources/Version.h"
+#include "Algo/BinarySearch.h"
 #include "Core/VoxelMeshProxy.hpp"
 
 
@@ -19,9 +21,8 @@ UVoxelMeshComponent::UVoxelMeshComponent(const FObjectInitializer& ObjectInitial
 }
 
 FPrimitiveSceneProxy* UVoxelMeshComponent::CreateSceneProxy() {
-	FVoxelMeshSceneProxy* NewProxy = new FVoxelMeshSceneProxy(this);
-	MeshSectionLodArray.Empty(); // clear mesh data to reduce memory usage
-	return NewProxy;
+	// render sections are kept with mesh data: recreated render state copies them again, no repack on game thread
+	return new FVoxelMeshSceneProxy(this);
 }
 
 void UVoxelMeshComponent::PostLoad() {
@@ -47,47 +48,38 @@ void UVoxelMeshComponent::SetMeshData(TMeshDataPtr NewMeshDataPtr) {
 
 	LocalMaterials.Empty();
 	LocalMaterials.Reserve(10);
-	MeshSectionLodArray.SetNum(LOD_ARRAY_SIZE);
 
-	if (NewMeshDataPtr) {
-		auto LodIndex = 0;
-		for (auto& SectionLOD : NewMeshDataPtr->MeshSectionLodArray) {
-			const auto* SourceMesh = &SectionLOD;
+	// no mesh copy. render sections are normally prepared by worker before apply
+	MeshDataPtr = NewMeshDataPtr;
 
-			MeshSectionLodArray[LodIndex].WholeMesh = SourceMesh->WholeMesh;
-			MeshSectionLodArray[LodIndex].RegularMeshContainer.MaterialSectionMap = SourceMesh->RegularMeshContainer.MaterialSectionMap;
-			MeshSectionLodArray[LodIndex].RegularMeshContainer.MaterialTransitionSectionMap = SourceMesh->RegularMeshContainer.MaterialTransitionSectionMap;
+	if (MeshDataPtr) {
+		const bool bMergeMaterials = TerrainController != nullptr && TerrainController->IsMergedLodSections();
+		MeshDataPtr->PrepareRenderData(bMergeMaterials);
 
-			if (TerrainController != nullptr) {
-				for (auto& Element : SourceMesh->RegularMeshContainer.MaterialSectionMap) {
-					UMaterialInterface* Material = TerrainController->GetRegularTerrainMaterial(Element.Key);
-					LocalMaterials.Add(Material);
+		if (bMergeMaterials) {
+			LocalMaterials.Add(TerrainController->MergedMaterial);
+		} else if (TerrainController != nullptr) {
+			for (const auto& SectionLOD : MeshDataPtr->MeshSectionLodArray) {
+				for (const auto& Element : SectionLOD.RegularMeshContainer.MaterialSectionMap) {
+					LocalMaterials.Add(TerrainController->GetRegularTerrainMaterial(Element.Key));
 				}
 
-				for (const auto& Element : SourceMesh->RegularMeshContainer.MaterialTransitionSectionMap) {
+				for (const auto& Element : SectionLOD.RegularMeshContainer.MaterialTransitionSectionMap) {
 					LocalMaterials.Add(TerrainController->GetTransitionMaterial(Element.Value.MaterialIdSet));
 				}
-			}
-			if (bLodFlag) {
-				for (auto i = 0; i < 6; i++) {
-					MeshSectionLodArray[LodIndex].TransitionPatchArray[i].MaterialSectionMap = SourceMesh->TransitionPatchArray[i].MaterialSectionMap;
-					MeshSectionLodArray[LodIndex].TransitionPatchArray[i].MaterialTransitionSectionMap = SourceMesh->TransitionPatchArray[i].MaterialTransitionSectionMap;
-
-					if (TerrainController != nullptr) {
-						for (auto& Element : SourceMesh->TransitionPatchArray[i].MaterialSectionMap) {
-							UMaterialInterface* Material = TerrainController->GetRegularTerrainMaterial(Element.Key);
-							LocalMaterials.Add(Material);
+
+				if (bLodFlag) {
+					for (auto i = 0; i < 6; i++) {
+						for (const auto& Element : SectionLOD.TransitionPatchArray[i].MaterialSectionMap) {
+							LocalMaterials.Add(TerrainController->GetRegularTerrainMaterial(Element.Key));
 						}
 
-						for (const auto& Element : SourceMesh->TransitionPatchArray[i].MaterialTransitionSectionMap) {
+						for (const auto& Element : SectionLOD.TransitionPatchArray[i].MaterialTransitionSectionMap) {
 							LocalMaterials.Add(TerrainController->GetTransitionMaterial(Element.Value.MaterialIdSet));
 						}
 					}
-
 				}
 			}
-
-			LodIndex++;
 		}
 	}
 
@@ -95,6 +87,65 @@ void UVoxelMeshComponent::SetMeshData(TMeshDataPtr NewMeshDataPtr) {
 	MarkRenderStateDirty(); // New section requires recreating scene proxy
 }
 
+// drop render and collision mesh. component stays registered
+void UVoxelMeshComponent::ClearMeshData() {
+	LocalMaterials.Empty();
+	MeshDataPtr = nullptr;
+	CollisionMeshDataPtr = nullptr;
+	UpdateCollision();
+	MarkRenderStateDirty();
+}
+
+TMeshDataPtr UVoxelMeshComponent::GetMeshData() const {
+	return MeshDataPtr;
+}
+
+void UVoxelMeshComponent::SetLodState(const int32 LodIndex, const uint8 PatchMask) {
+	if (FixedLodIndex == LodIndex && TransitionPatchMask == PatchMask) {
+		return;
+	}
+
+	FixedLodIndex = LodIndex;
+	TransitionPatchMask = PatchMask;
+
+	if (SceneProxy) {
+		FVoxelMeshSceneProxy* VoxelMeshSceneProxy = (FVoxelMeshSceneProxy*)SceneProxy;
+		ENQUEUE_RENDER_COMMAND(FVoxelMeshSetLodState)([VoxelMeshSceneProxy, LodIndex, PatchMask](FRHICommandListImmediate& RHICmdList) {
+			VoxelMeshSceneProxy->SetLodState_RenderThread(LodIndex, PatchMask);
+		});
+	}
+}
+
+void UVoxelMeshComponent::SetBatched(const bool bNewBatched) {
+	if (bBatched == bNewBatched) {
+		return;
+	}
+
+	bBatched = bNewBatched;
+
+	if (SceneProxy) {
+		FVoxelMeshSceneProxy* VoxelMeshSceneProxy = (FVoxelMeshSceneProxy*)SceneProxy;
+		ENQUEUE_RENDER_COMMAND(FVoxelMeshSetBatched)([VoxelMeshSceneProxy, bNewBatched](FRHICommandListImmediate& RHICmdList) {
+			VoxelMeshSceneProxy->SetBatched_RenderThread(bNewBatched);
+		});
+	}
+}
+
+void UVoxelMeshComponent::SetOccluded(const bool bNewOccluded) {
+	if (bOccluded == bNewOccluded) {
+		return;
+	}
+
+	bOccluded = bNewOccluded;
+
+	if (SceneProxy) {
+		FVoxelMeshSceneProxy* VoxelMeshSceneProxy = (FVoxelMeshSceneProxy*)SceneProxy;
+		ENQUEUE_RENDER_COMMAND(FVoxelMeshSetOccluded)([VoxelMeshSceneProxy, bNewOccluded](FRHICommandListImmediate& RHICmdList) {
+			VoxelMeshSceneProxy->SetOccluded_RenderThread(bNewOccluded);
+		});
+	}
+}
+
 FBoxSphereBounds UVoxelMeshComponent::CalcBounds(const FTransform& LocalToWorld) const {
 	return LocalBounds.TransformBy(LocalToWorld);
 }
@@ -137,6 +188,11 @@ void UVoxelMeshComponent::AddCollisionSection(struct FTriMeshCollisionData* Coll
 }
 
 bool UVoxelMeshComponent::GetPhysicsTriMeshData(struct FTriMeshCollisionData* CollisionData, bool InUseAllTriData) {
+	// collision is in chunks
+	if (GetCollisionChunkSplit() > 1) {
+		return false;
+	}
+
 	int32 VertexBase = 0;
 
 	bool bCopyUVs = UPhysicsSettings::Get()->bSupportUVFromHitResults;
@@ -144,7 +200,12 @@ bool UVoxelMeshComponent::GetPhysicsTriMeshData(struct FTriMeshCollisionData* Co
 		CollisionData->UVs.AddZeroed(1); // only one UV channel
 	}
 
-	const TMeshLodSection& CollisionSection = CollisionLodSection;
+	const TMeshLodSection* CollisionSectionPtr = GetCollisionLodSection();
+	if (CollisionSectionPtr == nullptr) {
+		return false;
+	}
+
+	const TMeshLodSection& CollisionSection = *CollisionSectionPtr;
 	for (const auto& Elem : CollisionSection.RegularMeshContainer.MaterialSectionMap) {
 		int32 MatId = (int32)Elem.Key;
 		const TMeshMaterialSection& MaterialSection = Elem.Value;
@@ -193,13 +254,27 @@ void UVoxelMeshComponent::UpdateLocalBounds() {
 
 
 bool UVoxelMeshComponent::ContainsPhysicsTriMeshData(bool InUseAllTriData) const {
-	if (CollisionLodSection.RegularMeshContainer.MaterialSectionMap.Num() == 0) {
+	if (GetCollisionChunkSplit() > 1) {
+		return false;
+	}
+
+	const TMeshLodSection* CollisionSectionPtr = GetCollisionLodSection();
+	if (CollisionSectionPtr == nullptr || CollisionSectionPtr->RegularMeshContainer.MaterialSectionMap.Num() == 0) {
 		return false;
 	}
 
 	return true;
 }
 
+const TMeshLodSection* UVoxelMeshComponent::GetCollisionLodSection() const {
+	if (!CollisionMeshDataPtr) {
+		return nullptr;
+	}
+
+	const int32 LodIdx = CollisionMeshDataPtr->GetCollisionLodIndex(CollisionLodIndex);
+	return (LodIdx >= 0) ? &CollisionMeshDataPtr->MeshSectionLodArray[LodIdx] : nullptr;
+}
+
 void UVoxelMeshComponent::CreateProcMeshBodySetup() {
 	if (!ProcMeshBodySetup) {
 		// The body setup in a template needs to be public since the property is Tnstanced and thus is the archetype of the instance meaning there is a direct reference
@@ -270,6 +345,16 @@ void UVoxelMeshComponent::FinishPhysicsAsyncCook(bool bSuccess, UBodySetup* Fini
 }
 
 void UVoxelMeshComponent::UpdateCollision() {
+	const int32 Split = GetCollisionChunkSplit();
+	if (Split > 1) {
+		CollisionFaceRangeEnd.Empty();
+		CollisionFaceRangeMaterial.Empty();
+		UpdateCollisionChunks(Split);
+		return;
+	}
+
+	BuildCollisionFaceMaterialTable();
+
 	// Abort all previous ones still standing
 	for (UBodySetup* OldBody : AsyncBodySetupQueue) {
 		OldBody->AbortPhysicsMeshAsyncCreation();
@@ -291,31 +376,410 @@ UBodySetup* UVoxelMeshComponent::GetBodySetup() {
 	return ProcMeshBodySetup;
 }
 
-void UVoxelMeshComponent::SetCollisionMeshData(TMeshDataPtr MeshDataPtr) {
-	CollisionLodSection = MeshSectionLodArray[0];
+void UVoxelMeshComponent::SetCollisionMeshData(TMeshDataPtr NewMeshDataPtr) {
+	CollisionMeshDataPtr = NewMeshDataPtr;
 	//UpdateLocalBounds();
 	UpdateCollision();
 }
 
+void UVoxelMeshComponent::SetCollisionLod(const int32 LodIndex) {
+	if (CollisionLodIndex == LodIndex) {
+		return;
+	}
+
+	CollisionLodIndex = LodIndex;
 
-TMaterialId UVoxelMeshComponent::GetMaterialIdFromCollisionFaceIndex(int32 FaceIndex) const {
-	if (FaceIndex >= 0) {
-		int32 TotalFaceCount = 0;
-		const TMeshLodSection& CollisionSection = CollisionLodSection;
-		for (const auto& Elem : CollisionSection.RegularMeshContainer.MaterialSectionMap) {
-			int32 MatId = (int32)Elem.Key;
-			const TMeshMaterialSection& MaterialSection = Elem.Value;
-			const FProcMeshSection& MeshSection = MaterialSection.MaterialMesh;
-
-			int32 NumFaces = MeshSection.ProcIndexBuffer.Num() / 3;
-			TotalFaceCount += NumFaces;
-
-			if (FaceIndex < TotalFaceCount) {
-				return MaterialSection.MaterialId;
+	if (CollisionMeshDataPtr) {
+		UpdateCollision();
+	}
+}
+
+int32 UVoxelMeshComponent::GetCollisionLod() const {
+	return CollisionLodIndex;
+}
+
+// ======================================================================
+// collision chunks
+// ======================================================================
+
+int32 UVoxelMeshComponent::GetCollisionChunkSplit() const {
+	const ASandboxTerrainController* TerrainController = Cast<ASandboxTerrainController>(GetAttachmentRootActor());
+	return TerrainController ? TerrainController->GetCollisionChunkSplit() : 1;
+}
+
+// triangles are bucketed by centroid, so every triangle belongs to one chunk and there are no gaps.
+// chunk vertices are remapped in order of first use: unchanged part of mesh gives the same chunk data
+static void BuildCollisionChunks(const TMeshLodSection* CollisionSectionPtr, const int32 Split, TArray<TCollisionChunkData>& ChunkDataArray) {
+	ChunkDataArray.SetNum(Split * Split * Split);
+	if (CollisionSectionPtr == nullptr) {
+		return;
+	}
+
+	const float ChunkSize = USBT_ZONE_SIZE / (float)Split;
+	const float HalfZone = USBT_ZONE_SIZE / 2.f;
+
+	// last chunk and chunk vertex index of source vertex. vertex on chunk border is added to each chunk
+	TArray<TPair<int32, int32>> VertexRemap;
+
+	auto ClcChunkCrd = [&](const float Val) {
+		return FMath::Clamp(FMath::FloorToInt((Val + HalfZone) / ChunkSize), 0, Split - 1);
+	};
+
+	auto AddSection = [&](const FProcMeshSection& MeshSection, const TMaterialId MatId) {
+		VertexRemap.Init(TPair<int32, int32>(-1, -1), MeshSection.ProcVertexBuffer.Num());
+
+		const int32 NumTriangles = MeshSection.ProcIndexBuffer.Num() / 3;
+		for (int32 TriIdx = 0; TriIdx < NumTriangles; TriIdx++) {
+			const uint32 I0 = MeshSection.ProcIndexBuffer[TriIdx * 3 + 0];
+			const uint32 I1 = MeshSection.ProcIndexBuffer[TriIdx * 3 + 1];
+			const uint32 I2 = MeshSection.ProcIndexBuffer[TriIdx * 3 + 2];
+
+			const FVector Center = (FVector(MeshSection.ProcVertexBuffer[I0].Pos) + FVector(MeshSection.ProcVertexBuffer[I1].Pos) + FVector(MeshSection.ProcVertexBuffer[I2].Pos)) / 3.f;
+			const int32 ChunkIdx = ClcChunkCrd(Center.X) + ClcChunkCrd(Center.Y) * Split + ClcChunkCrd(Center.Z) * Split * Split;
+			TCollisionChunkData& ChunkData = ChunkDataArray[ChunkIdx];
+
+			auto MapVertex = [&](const uint32 SrcIdx) {
+				TPair<int32, int32>& Remap = VertexRemap[SrcIdx];
+				if (Remap.Key != ChunkIdx) {
+					Remap.Key = ChunkIdx;
+					Remap.Value = ChunkData.Vertices.Add(TPackedVertexVector(MeshSection.ProcVertexBuffer[SrcIdx].Pos));
+				}
+
+				return Remap.Value;
+			};
+
+			FTriIndices Triangle;
+			Triangle.v0 = MapVertex(I0);
+			Triangle.v1 = MapVertex(I1);
+			Triangle.v2 = MapVertex(I2);
+			ChunkData.Indices.Add(Triangle);
+			ChunkData.MaterialIds.Add(MatId);
+		}
+	};
+
+	for (const auto& Elem : CollisionSectionPtr->RegularMeshContainer.MaterialSectionMap) {
+		AddSection(Elem.Value.MaterialMesh, Elem.Value.MaterialId);
+	}
+
+	// transition face gets first material of set
+	for (const auto& Elem : CollisionSectionPtr->RegularMeshContainer.MaterialTransitionSectionMap) {
+		const TMaterialId MatId = Elem.Value.MaterialIdSet.empty() ? 0 : *Elem.Value.MaterialIdSet.begin();
+		AddSection(Elem.Value.MaterialMesh, MatId);
+	}
+
+	for (TCollisionChunkData& ChunkData : ChunkDataArray) {
+		if (ChunkData.Indices.Num() > 0) {
+			uint32 Crc = FCrc::MemCrc32(ChunkData.Vertices.GetData(), ChunkData.Vertices.Num() * ChunkData.Vertices.GetTypeSize());
+			Crc = FCrc::MemCrc32(ChunkData.Indices.GetData(), ChunkData.Indices.Num() * ChunkData.Indices.GetTypeSize(), Crc);
+			Crc = FCrc::MemCrc32(ChunkData.MaterialIds.GetData(), ChunkData.MaterialIds.Num() * ChunkData.MaterialIds.GetTypeSize(), Crc);
+			ChunkData.Hash = (Crc != 0) ? Crc : 1;
+		}
+	}
+}
+
+// only chunks with changed triangles are cooked again. chunks and crc are normally built by worker before apply
+void UVoxelMeshComponent::UpdateCollisionChunks(const int32 Split) {
+	if (!CollisionMeshDataPtr) {
+		return;
+	}
+
+	CollisionMeshDataPtr->ReadCollisionChunks(Split, CollisionLodIndex, [&](const TArray<TCollisionChunkData>& ChunkDataArray) {
+		if (CollisionChunkArray.Num() != ChunkDataArray.Num()) {
+			for (UTerrainCollisionChunkComponent* Chunk : CollisionChunkArray) {
+				if (Chunk) {
+					Chunk->DestroyComponent();
+				}
+			}
+
+			CollisionChunkArray.Init(nullptr, ChunkDataArray.Num());
+		}
+
+		for (int32 ChunkIdx = 0; ChunkIdx < ChunkDataArray.Num(); ChunkIdx++) {
+			const TCollisionChunkData& ChunkData = ChunkDataArray[ChunkIdx];
+			UTerrainCollisionChunkComponent* Chunk = CollisionChunkArray[ChunkIdx];
+			if (!Chunk) {
+				if (ChunkData.Indices.Num() == 0) {
+					continue;
+				}
+
+				Chunk = CreateCollisionChunk(ChunkIdx);
+				CollisionChunkArray[ChunkIdx] = Chunk;
+			}
+
+			if (Chunk->GetChunkHash() != ChunkData.Hash) {
+				Chunk->SetChunkData(ChunkData);
 			}
+		}
+	});
+}
+
+UTerrainCollisionChunkComponent* UVoxelMeshComponent::CreateCollisionChunk(const int32 ChunkIdx) {
+	const FString Name = FString::Printf(TEXT("CollisionChunk [%d, %d, %d] %d"), ZoneIndex.X, ZoneIndex.Y, ZoneIndex.Z, ChunkIdx);
+	UTerrainCollisionChunkComponent* Chunk = NewObject<UTerrainCollisionChunkComponent>(GetOwner(), MakeUniqueObjectName(GetOwner(), UTerrainCollisionChunkComponent::StaticClass(), FName(*Name)));
+	Chunk->ChunkIndex = ChunkIdx;
+	Chunk->SetMobility(EComponentMobility::Movable);
+	Chunk->SetCanEverAffectNavigation(true);
+	Chunk->RegisterComponent();
+	Chunk->AttachToComponent(this, FAttachmentTransformRules::KeepRelativeTransform, NAME_None);
+	Chunk->SetCollisionProfileName(GetCollisionProfileName());
+	Chunk->SetCollisionEnabled(GetCollisionEnabled());
+	return Chunk;
+}
 
+void UVoxelMeshComponent::SyncCollisionChunkSettings() {
+	for (UTerrainCollisionChunkComponent* Chunk : CollisionChunkArray) {
+		if (Chunk) {
+			Chunk->SetCollisionProfileName(GetCollisionProfileName());
+			Chunk->SetCollisionEnabled(GetCollisionEnabled());
+		}
+	}
+}
+
+
+// sections in order of GetPhysicsTriMeshData. neighbor ranges of same material are merged
+void UVoxelMeshComponent::BuildCollisionFaceMaterialTable() {
+	CollisionFaceRangeEnd.Reset();
+	CollisionFaceRangeMaterial.Reset();
+
+	const TMeshLodSection* CollisionSectionPtr = GetCollisionLodSection();
+	if (CollisionSectionPtr == nullptr) {
+		return;
+	}
+
+	int32 TotalFaceCount = 0;
+	auto AddRange = [&](const int32 NumFaces, const TMaterialId MatId) {
+		if (NumFaces == 0) {
+			return;
+		}
+
+		TotalFaceCount += NumFaces;
+		if (CollisionFaceRangeMaterial.Num() > 0 && CollisionFaceRangeMaterial.Last() == MatId) {
+			CollisionFaceRangeEnd.Last() = TotalFaceCount;
+		} else {
+			CollisionFaceRangeEnd.Add(TotalFaceCount);
+			CollisionFaceRangeMaterial.Add(MatId);
+		}
+	};
+
+	for (const auto& Elem : CollisionSectionPtr->RegularMeshContainer.MaterialSectionMap) {
+		AddRange(Elem.Value.MaterialMesh.ProcIndexBuffer.Num() / 3, Elem.Value.MaterialId);
+	}
+
+	// transition face gets first material of set
+	for (const auto& Elem : CollisionSectionPtr->RegularMeshContainer.MaterialTransitionSectionMap) {
+		const TMaterialId MatId = Elem.Value.MaterialIdSet.empty() ? 0 : *Elem.Value.MaterialIdSet.begin();
+		AddRange(Elem.Value.MaterialMesh.ProcIndexBuffer.Num() / 3, MatId);
+	}
+}
+
+TMaterialId UVoxelMeshComponent::GetMaterialIdFromCollisionFaceIndex(int32 FaceIndex) const {
+	if (FaceIndex < 0) {
+		return 0;
+	}
+
+	const int32 RangeIdx = Algo::UpperBound(CollisionFaceRangeEnd, FaceIndex);
+	return (RangeIdx < CollisionFaceRangeMaterial.Num()) ? CollisionFaceRangeMaterial[RangeIdx] : 0;
+}
+
+void UVoxelMeshComponent::GetMaterialIdsFromCollisionFaceIndices(const TArray<int32>& FaceIndexArray, TArray<TMaterialId>& OutMaterialIdArray) const {
+	OutMaterialIdArray.SetNumUninitialized(FaceIndexArray.Num());
+	for (int32 Idx = 0; Idx < FaceIndexArray.Num(); Idx++) {
+		OutMaterialIdArray[Idx] = GetMaterialIdFromCollisionFaceIndex(FaceIndexArray[Idx]);
+	}
+}
+
+// ================================================================================================================================================
+// render data
+// ================================================================================================================================================
+
+// blend weight of transition material per vertex material index
+static const FColor MatIdxColor[4] = { FColor(255, 0, 0, 0), FColor(0, 255, 0, 0), FColor(0, 0, 255, 0), FColor(0, 0, 0, 0) };
+
+static void AppendRenderVertices(TMeshRenderSection& RenderSection, const FProcMeshSection& Section, const bool bForceFirstMaterial) {
+	// ignore tangent. with Y = Z x X basis determinant is always positive
+	const FPackedNormal TangentX(TPackedVertexVector(1.f, 0.f, 0.f));
+
+	for (const TMeshVertex& ProcVert : Section.ProcVertexBuffer) {
+		RenderSection.Positions.Add(TPackedVertexVector(ProcVert.Pos));
+		RenderSection.Tangents.Add(TangentX);
+		RenderSection.Tangents.Add(FPackedNormal(TPackedVertexVector4(TPackedVertexVector(ProcVert.Normal), 1.f)));
+		RenderSection.Colors.Add(bForceFirstMaterial ? MatIdxColor[0] : MatIdxColor[(uint32)ProcVert.MatIdx < 3 ? ProcVert.MatIdx : 3]);
+	}
+}
+
+TMeshRenderSectionPtr BuildMeshRenderSection(const FProcMeshSection& Section) {
+	if (Section.ProcIndexBuffer.Num() == 0 || Section.ProcVertexBuffer.Num() == 0) {
+		return nullptr;
+	}
+
+	const int32 NumVerts = Section.ProcVertexBuffer.Num();
+
+	std::shared_ptr<TMeshRenderSection> RenderSection = std::make_shared<TMeshRenderSection>();
+	RenderSection->Positions.Reserve(NumVerts);
+	RenderSection->Tangents.Reserve(NumVerts * 2);
+	RenderSection->Colors.Reserve(NumVerts);
+	RenderSection->Indices = Section.ProcIndexBuffer;
+
+	AppendRenderVertices(*RenderSection, Section, false);
+	return RenderSection;
+}
+
+// material ids are stored as half float, exact up to 2048
+static void AppendMergedSection(TMeshRenderSection& RenderSection, const FProcMeshSection& Section, const unsigned short (&MaterialId)[3], const bool bTransition) {
+	const uint32 VertexBase = RenderSection.Positions.Num();
+
+	AppendRenderVertices(RenderSection, Section, !bTransition);
+
+	for (int32 VertIdx = 0; VertIdx < Section.ProcVertexBuffer.Num(); VertIdx++) {
+		RenderSection.TexCoords.Add(FVector2DHalf((float)MaterialId[0], (float)MaterialId[1]));
+		RenderSection.TexCoords.Add(FVector2DHalf((float)MaterialId[2], 0.f));
+	}
+
+	for (uint32 Index : Section.ProcIndexBuffer) {
+		RenderSection.Indices.Add(VertexBase + Index);
+	}
+}
+
+TMeshRenderSectionPtr BuildMergedMeshRenderSection(const TMeshContainer& MeshContainer) {
+	int32 NumVerts = 0;
+	int32 NumIndices = 0;
+
+	for (const auto& Element : MeshContainer.MaterialSectionMap) {
+		NumVerts += Element.Value.MaterialMesh.ProcVertexBuffer.Num();
+		NumIndices += Element.Value.MaterialMesh.ProcIndexBuffer.Num();
+	}
+
+	for (const auto& Element : MeshContainer.MaterialTransitionSectionMap) {
+		NumVerts += Element.Value.MaterialMesh.ProcVertexBuffer.Num();
+		NumIndices += Element.Value.MaterialMesh.ProcIndexBuffer.Num();
+	}
+
+	if (NumVerts == 0 || NumIndices == 0) {
+		return nullptr;
+	}
+
+	std::shared_ptr<TMeshRenderSection> RenderSection = std::make_shared<TMeshRenderSection>();
+	RenderSection->Positions.Reserve(NumVerts);
+	RenderSection->Tangents.Reserve(NumVerts * 2);
+	RenderSection->Colors.Reserve(NumVerts);
+	RenderSection->TexCoords.Reserve(NumVerts * 2);
+	RenderSection->Indices.Reserve(NumIndices);
+
+	for (const auto& Element : MeshContainer.MaterialSectionMap) {
+		const unsigned short MatId = Element.Value.MaterialId;
+		const unsigned short MaterialId[3] = { MatId, MatId, MatId };
+		AppendMergedSection(*RenderSection, Element.Value.MaterialMesh, MaterialId, false);
+	}
+
+	for (const auto& Element : MeshContainer.MaterialTransitionSectionMap) {
+		// same order as vertex material index
+		unsigned short MaterialId[3] = { 0, 0, 0 };
+		int Idx = 0;
+		for (unsigned short MatId : Element.Value.MaterialIdSet) {
+			MaterialId[Idx] = MatId;
+			if (++Idx == 3) break;
+		}
+
+		AppendMergedSection(*RenderSection, Element.Value.MaterialMesh, MaterialId, true);
+	}
+
+	return RenderSection;
+}
+
+void AppendMeshRenderSection(TMeshRenderSection& Target, const TMeshRenderSection& Source, const TPackedVertexVector& Offset) {
+	const uint32 VertexBase = Target.Positions.Num();
+
+	Target.Positions.Reserve(VertexBase + Source.Positions.Num());
+	for (const TPackedVertexVector& Pos : Source.Positions) {
+		Target.Positions.Add(Pos + Offset);
+	}
+
+	Target.Tangents.Append(Source.Tangents);
+	Target.Colors.Append(Source.Colors);
+	Target.TexCoords.Append(Source.TexCoords);
+
+	Target.Indices.Reserve(Target.Indices.Num() + Source.Indices.Num());
+	for (uint32 Index : Source.Indices) {
+		Target.Indices.Add(VertexBase + Index);
+	}
+}
+
+template<class T>
+static void PrepareMaterialRenderSections(TMap<unsigned short, T>& MaterialMap) {
+	for (auto& Element : MaterialMap) {
+		TMeshMaterialSection& MaterialSection = static_cast<TMeshMaterialSection&>(Element.Value);
+		if (!MaterialSection.RenderSection) {
+			MaterialSection.RenderSection = BuildMeshRenderSection(MaterialSection.MaterialMesh);
+		}
+	}
+}
+
+static void PrepareContainerRenderSections(TMeshContainer& MeshContainer, const bool bMergeMaterials) {
+	if (bMergeMaterials) {
+		MeshContainer.MergedRenderSection = BuildMergedMeshRenderSection(MeshContainer);
+	} else {
+		PrepareMaterialRenderSections(MeshContainer.MaterialSectionMap);
+		PrepareMaterialRenderSections(MeshContainer.MaterialTransitionSectionMap);
+	}
+}
+
+void TMeshData::PrepareRenderData(const bool bMergeMaterials) {
+	const std::lock_guard<std::mutex> Lock(RenderDataMutex);
+	PrepareRenderDataInternal(bMergeMaterials);
+}
+
+int32 TMeshData::GetCollisionLodIndex(const int32 LodIndex) const {
+	if (LodIndex < 0 || MeshSectionLodArray.Num() == 0) {
+		return -1;
+	}
+
+	for (int32 LodIdx = FMath::Min(LodIndex, MeshSectionLodArray.Num() - 1); LodIdx > 0; LodIdx--) {
+		if (MeshSectionLodArray[LodIdx].RegularMeshContainer.MaterialSectionMap.Num() > 0) {
+			return LodIdx;
 		}
 	}
 
 	return 0;
 }
+
+void TMeshData::PrepareCollisionChunks(const int32 Split, const int32 LodIndex) {
+	const std::lock_guard<std::mutex> Lock(RenderDataMutex);
+	const int32 CollisionLod = GetCollisionLodIndex(LodIndex);
+	if (CollisionLod >= 0) {
+		PrepareCollisionChunksInternal(Split, CollisionLod);
+	}
+}
+
+// chunks of other split are dropped
+void TMeshData::PrepareCollisionChunksInternal(const int32 Split, const int32 LodIndex) {
+	if (CollisionChunkSplit != Split) {
+		CollisionChunkSplit = Split;
+		for (auto& ChunkDataArray : CollisionChunkLodArray) {
+			ChunkDataArray.Empty();
+		}
+	}
+
+	TArray<TCollisionChunkData>& ChunkDataArray = CollisionChunkLodArray[LodIndex];
+	if (ChunkDataArray.Num() == 0) {
+		BuildCollisionChunks(&MeshSectionLodArray[LodIndex], Split, ChunkDataArray);
+	}
+}
+
+void TMeshData::PrepareRenderDataInternal(const bool bMergeMaterials) {
+	if (bRenderDataReady) {
+		return;
+	}
+
+	for (TMeshLodSection& LodSection : MeshSectionLodArray) {
+		PrepareContainerRenderSections(LodSection.RegularMeshContainer, bMergeMaterials);
+
+		for (TMeshContainer& Patch : LodSection.TransitionPatchArray) {
+			PrepareContainerRenderSections(Patch, bMergeMaterials);
+		}
+
+		// copy of all material meshes of lod. material meshes stay for collision, save and rebuild
+		LodSection.WholeMesh.Reset();
+	}
+
+	bRenderDataReady = true;
+}
@@ -0,0 +1,51 @@
+// Copyright blackw 2015-2020
+
+#pragma once
+
+#include "EngineMinimal.h"
+#include "Components/MeshComponent.h"
+#include "VoxelMeshData.h"
+#include "FarTerrainComponent.generated.h"
+
+
+/**
+* coarse terrain mesh of one region. drawn beyond active area instead of zones
+*/
+UCLASS()
+class UNREALSANDBOXTERRAIN_API UFarTerrainComponent : public UMeshComponent {
+	GENERATED_UCLASS_BODY()
+
+public:
+
+	TVoxelIndex RegionIndex;
+
+	void SetFarTerrainMeshData(TFarTerrainMeshDataPtr NewMeshDataPtr, UMaterialInterface* Material);
+
+	// game thread. cells covered by loaded zones are not drawn. pushed to existing proxy, no render state recreation
+	void SetCoveredCells(const TBitArray<>& NewCoveredCellMask);
+
+	//~ Begin UPrimitiveComponent Interface.
+	virtual FPrimitiveSceneProxy* CreateSceneProxy() override;
+	//~ End UPrimitiveComponent Interface.
+
+	//~ Begin UMeshComponent Interface.
+	virtual int32 GetNumMaterials() const override;
+	//~ End UMeshComponent Interface.
+
+	virtual void GetUsedMaterials(TArray<UMaterialInterface*>& OutMaterials, bool bGetDebugMaterials = false) const override;
+
+private:
+
+	//~ Begin USceneComponent Interface.
+	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+	//~ Begin USceneComponent Interface.
+
+	TFarTerrainMeshDataPtr MeshDataPtr;
+
+	TBitArray<> CoveredCellMask;
+
+	UPROPERTY()
+	UMaterialInterface* FarTerrainMaterial;
+
+	friend class FFarTerrainSceneProxy;
+};
@@ -84,6 +84,10 @@ public:
 		SectionLocalBox = A.SectionLocalBox;
 	}
 
+	SIZE_T GetAllocatedSize() const {
+		return ProcVertexBuffer.GetAllocatedSize() + ProcIndexBuffer.GetAllocatedSize();
+	}
+
 	void AddVertex(const TMeshVertex& Vertex) {
 		ProcVertexBuffer.Add(Vertex);
 		SectionLocalBox += Vertex.Pos;
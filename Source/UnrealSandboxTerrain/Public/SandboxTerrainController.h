@@ -7,6 +7,7 @@
 #include <memory>
 #include <queue>
 #include <mutex>
+#include <atomic>
 #include <list>
 #include <shared_mutex>
 #include <set>
@@ -17,7 +18,11 @@
 #include "SandboxTerrainController.generated.h"
 
 struct TMeshData;
+struct TFarTerrainMeshData;
+struct TZoneBatchMeshData;
 class UVoxelMeshComponent;
+class UFarTerrainComponent;
+class UTerrainBatchComponent;
 class UTerrainZoneComponent;
 struct TInstanceMeshArray;
 class TTerrainData;
@@ -217,6 +222,17 @@ typedef struct TChunkIndex {
 
 } TChunkIndex;
 
+// game thread conveyor task class. lower runs first
+enum class TConveyorTaskClass : int {
+	Edit = 0,
+	Mesh = 1,
+	Spawn = 2,
+	Default = 3,
+};
+
+// last class is default
+static constexpr int ConveyorTaskClassNum = (int)TConveyorTaskClass::Default + 1;
+
 enum class TZoneFlag : uint32 {
 	Generated = 0, // Not used
 	NoMesh = 1,
@@ -224,6 +240,39 @@ enum class TZoneFlag : uint32 {
 	InternalSolid = 3,
 };
 
+// queued zone mesh apply. several updates of one zone are merged
+typedef struct TZoneApplyItem {
+	TMeshDataPtr MeshDataPtr = nullptr;
+	bool bAddZone = false;
+	bool bIsNewGenerated = false;
+	bool bIsChanged = false;
+	bool bNeedSave = false;
+	TConveyorTaskClass TaskClass = TConveyorTaskClass::Mesh;
+	float Priority = 0;
+} TZoneApplyItem;
+
+// zone of batched cell. lod state is taken from zone mesh component
+typedef struct TZoneBatchItem {
+	TVoxelIndex ZoneIndex;
+	TMeshDataPtr MeshDataPtr = nullptr;
+	int32 LodIndex = 0;
+	uint8 PatchMask = 0;
+} TZoneBatchItem;
+
+// key of queued async task. queued task with same key is replaced by newer one
+enum class TAsyncTaskType : uint32 {
+	ZoneRemesh = 1,
+	PlayerStreaming = 2,
+};
+
+FORCEINLINE uint64 ClcAsyncTaskKey(const TAsyncTaskType Type, const TVoxelIndex& Index) {
+	return ((uint64)Type << 60) | ((uint64)(Index.X & 0xFFFFF) << 40) | ((uint64)(Index.Y & 0xFFFFF) << 20) | (uint64)(Index.Z & 0xFFFFF);
+}
+
+FORCEINLINE uint64 ClcAsyncTaskKey(const TAsyncTaskType Type, const uint32 Id) {
+	return ((uint64)Type << 60) | (uint64)Id;
+}
+
 typedef struct TKvFileZoneData {
 	uint32 LenMd = 0;
 	uint32 CRC = 0; // unused
@@ -316,6 +365,41 @@ public:
 
 	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain General")
 	double ConveyorMaxTime = 0.05;
+
+	// conveyor time per frame is reduced when frame work time exceeds this target. capped frame rate or server tick rate raises it
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain General")
+	double ConveyorTargetFrameTime = 1.0 / 60.0;
+
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain General")
+	double ConveyorMinTime = 0.002;
+
+	// max count of zones applied by one conveyor task. actual count fits in conveyor budget left in frame
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain General")
+	int32 ZoneApplyBatchSize = 16;
+
+	// max count of unloaded zone components kept for reuse
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain General")
+	int32 ZonePoolSize = 256;
+
+	// memory budget for voxel data, mesh cache and instance objects. 0 - unlimited
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain General")
+	int32 ResidencyBudgetMb = 0;
+
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain General")
+	float ResidencyCheckPeriod = 5.f;
+
+	// zones farther than this from players, ai pawns, simulating physics objects and anchor objects get coarse collision, in zones. 0 - full collision everywhere
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain General")
+	uint32 CollisionRadius = 0;
+
+	// lod of collision mesh outside of collision radius. -1 - no collision until approached
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain General")
+	int32 CoarseCollisionLod = 2;
+
+	// zone collision is split to N x N x N chunks cooked separately, edit cooks again only changed chunks.
+	// hit component is UTerrainCollisionChunkComponent then. 1 - one collision mesh per zone
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain General")
+	uint32 CollisionChunkSplit = 1;
               
 	//========================================================================================
 	// LOD
@@ -324,6 +408,38 @@ public:
 	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain LOD")
 	float LodRatio = .5f;
 
+	// coarse per region terrain mesh beyond active area
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain LOD")
+	bool bEnableFarTerrain = false;
+
+	// far terrain radius in zones
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain LOD")
+	uint32 FarTerrainRadius = 400;
+
+	// far terrain grid step in zones
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain LOD")
+	uint32 FarTerrainStep = 2;
+
+	// zones of zone grid cell with coarse lod are combined to one primitive. requires precomputed lod transitions
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain LOD")
+	bool bEnableZoneBatching = false;
+
+	// min selected lod of all zones in zone grid cell to combine them. batched cell is kept down to one lod finer
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain LOD")
+	uint32 ZoneBatchLod = 3;
+
+	// min time from first change in batched cell to its rebuild, seconds. zones of cell are drawn meanwhile
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain LOD")
+	float ZoneBatchRebuildDelay = 1.f;
+
+	// zone lod and transition patches are selected on game thread when view moves. lod is drawn from cached static draw commands, patches by mask
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain LOD")
+	bool bPrecomputedLodTransitions = false;
+
+	// zones separated from view by fully solid zones are not drawn
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain LOD")
+	bool bEnableZoneOcclusion = false;
+
     //========================================================================================
     // Dynamic area streaming
     //========================================================================================
@@ -334,6 +450,26 @@ public:
     UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain Streaming")
     float PlayerLocationThreshold = 4000;
 
+	// prefetch ahead of player motion and view direction
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain Streaming")
+	bool bPredictiveStreaming = false;
+
+	// seconds of player velocity to load ahead. limited by quarter of active area
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain Streaming")
+	float StreamingLookaheadTime = 2.f;
+
+	// part of active area radius loaded behind moving player
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain Streaming")
+	float StreamingBehindRadiusRatio = 0.5f;
+
+	// load only zones near terrain surface, saved zones and zones with structures
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain Streaming")
+	bool bSurfaceStreaming = false;
+
+	// count of zones loaded above and below zones with geometry
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain Streaming")
+	int32 SurfaceStreamingMargin = 1;
+
 	//========================================================================================
 	// save/load
 	//========================================================================================
@@ -363,6 +499,18 @@ public:
 	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain Material")
 	USandboxTerrainParameters* TerrainParameters;
 
+	// one section per zone lod instead of one per material. material ids per vertex: uv0 = (id0, id1), uv1.x = id2, color rgb = weight
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain Material")
+	bool bMergeLodMaterialSections = false;
+
+	// max count of transition material instances created per frame ahead of zone apply. rest waits or is created by apply
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain Material")
+	int32 TransitionMaterialsPerFrame = 4;
+
+	// texture array material for merged sections
+	UPROPERTY(EditAnywhere, Category = "UnrealSandbox Terrain Material")
+	UMaterialInterface* MergedMaterial = nullptr;
+
 	//========================================================================================
 	// foliage
 	//========================================================================================
@@ -445,6 +593,11 @@ public:
 
 	UVoxelMeshComponent* GetVoxelMeshComponent(TVoxelIndex ZoneIndex);
 
+	// terrain material of hit face. hit query must return face index. not terrain - 0
+	uint16 GetMaterialIdFromHit(const FHitResult& Hit) const;
+
+	void GetMaterialIdsFromHits(const TArray<FHitResult>& HitArray, TArray<uint16>& OutMaterialIdArray) const;
+
 	void RemoveInstanceAtMesh(UInstancedStaticMeshComponent* InstancedMeshComp, int32 ItemIndex);
 
 	void RemoveInstanceAtMesh(TVoxelIndex ZoneIndex, uint32 TypeId, uint32 VariantId, int32 ItemIndex);
@@ -461,13 +614,21 @@ public:
 
 	UMaterialInterface* GetTransitionMaterial(const std::set<unsigned short>& MaterialIdSet);
 
+	void RegisterTransitionMaterials(const TMeshData& MeshData);
+
+	bool IsMergedLodSections() const;
+
+	// CollisionChunkSplit limited to 1..4
+	int32 GetCollisionChunkSplit() const;
+
 	const FTerrainInstancedMeshType* GetInstancedMeshType(uint32 MeshTypeId, uint32 MeshVariantId = 0) const;
 
 	//===============================================================================
 	// async tasks
 	//===============================================================================
 
-	void AddAsyncTask(std::function<void()> Function);
+	// TaskKey != 0: not started task with same key is replaced
+	void AddAsyncTask(std::function<void()> Function, const bool bHiPrio = false, const uint64 TaskKey = 0);
 
 	//========================================================================================
 	// network
@@ -531,6 +692,11 @@ private:
 
     TCheckAreaMap* CheckAreaMap;
 
+	UPROPERTY()
+	TArray<UTerrainZoneComponent*> ZonePool;
+
+	bool ReleaseZoneComponent(UTerrainZoneComponent* ZoneComponent);
+
     FTimerHandle TimerSwapArea;
     
     void PerformCheckArea();
@@ -546,10 +712,16 @@ private:
 	//===============================================================================
 
 	template<class H>
-	FORCEINLINE void PerformZoneEditHandler(const TVoxelIndex& Zoneindex, std::shared_ptr<TVoxelDataInfo> VdInfoPtr, H Handler, std::function<void(TMeshDataPtr)> OnComplete);
+	FORCEINLINE void PerformZoneEditHandler(const TVoxelIndex& Zoneindex, std::shared_ptr<TVoxelDataInfo> VdInfoPtr, H Handler);
+
+	// remesh after edit. several edits of one zone before remesh started are merged to one remesh
+	void QueueZoneRemesh(const TVoxelIndex& ZoneIndex);
 
 	void PerformEachZone(const FVector& Origin, const float Extend, std::function<void(TVoxelIndex, FVector, std::shared_ptr<TVoxelDataInfo>)>);
 
+	// undefined zone skipped by surface streaming gets state to load or generate on edit
+	bool ResolveSkippedZoneForEdit(const TVoxelIndex& ZoneIndex, std::shared_ptr<TVoxelDataInfo> VdInfoPtr);
+
 	//===============================================================================
 	// save/load
 	//===============================================================================
@@ -558,6 +730,18 @@ private:
     
     std::mutex SaveMutex;
 
+	void SaveZoneData(const TVoxelIndex& Index, std::shared_ptr<TVoxelDataInfo> VdInfoPtr);
+
+	//===============================================================================
+	// memory residency
+	//===============================================================================
+
+	std::atomic<bool> bResidencyCheckInProgress { false };
+
+	double LastResidencyCheck = 0;
+
+	void PerformResidencyCheck(const TArray<FVector>& PlayerLocationList);
+
 	bool bIsLoadFinished;
         
     void AutoSaveByTimer();
@@ -578,14 +762,48 @@ private:
 
 	TConveyour* Conveyor;
 
-	void AddTaskToConveyor(std::function<void()> Function);
+	// false: task is dropped
+	bool AddTaskToConveyor(std::function<void()> Function, const TConveyorTaskClass TaskClass = TConveyorTaskClass::Default, const float Priority = 0);
+
+	float ClcConveyorPriority(const TVoxelIndex& Index);
+
+	double ConveyorBudget = 0;
+
+	double ConveyorLastTime = 0;
+
+	// conveyor time spent in this frame before running task
+	double ConveyorFrameTime = 0;
 
-	void ExecGameThreadZoneApplyMesh(const TVoxelIndex& Index, UTerrainZoneComponent* Zone, TMeshDataPtr MeshDataPtr);
+	void ExecGameThreadZoneApplyMesh(const TVoxelIndex& Index, UTerrainZoneComponent* Zone, TMeshDataPtr MeshDataPtr, const bool bIsChanged = false);
 
 	void ExecGameThreadAddZoneAndApplyMesh(const TVoxelIndex& Index, TMeshDataPtr MeshDataPtr, const bool bIsNewGenerated = false, const bool bIsChanged = false);
 
 	void ExecGameThreadMoMeshZoneSpawn(const TArray<TVoxelIndex>& IndexList);
 
+	std::mutex ZoneApplyMutex;
+
+	std::unordered_map<TVoxelIndex, TZoneApplyItem> ZoneApplyMap;
+
+	// batch task is in conveyor, per task class
+	bool bZoneApplyBatchQueued[ConveyorTaskClassNum] = { };
+
+	void QueueZoneApply(const TVoxelIndex& Index, const TZoneApplyItem& NewItem);
+
+	// any thread. mesh of zone is waiting for game thread apply
+	bool IsZoneApplyQueued(const TVoxelIndex& Index);
+
+	// drop queued load of zone which became unreachable. changed or new generated zones are kept to be saved
+	void CancelUnreachableZoneApply(const TArray<FVector>& PlayerLocationList, const TArray<FVector>& AnchorObjectList);
+
+	void ExecZoneApplyBatch(const TConveyorTaskClass TaskClass);
+
+	void ExecZoneApplyMeshBatch(const std::vector<std::pair<TVoxelIndex, TZoneApplyItem>>& Batch);
+
+	// moving average of game thread time per zone: component creation, mesh apply
+	double ZoneSpawnCost = 0;
+
+	double ZoneApplyCost = 0;
+
 	//void ExecGameThreadRestoreSoftUnload(const TVoxelIndex& ZoneIndex);
 
 	//===============================================================================
@@ -636,6 +854,25 @@ private:
 
 	TMap<uint16, FSandboxTerrainMaterial> MaterialMap;
 
+	// transition material codes seen by workers. checked by workers without touching material instances
+	std::shared_timed_mutex TransitionMaterialCodeMutex;
+
+	std::unordered_set<uint64> TransitionMaterialCodeSet;
+
+	// registered sets waiting for material instance on game thread
+	std::vector<std::pair<uint64, std::set<unsigned short>>> PendingTransitionMaterialList;
+
+	// material instance was created after terrain load began. only then initial load reapplies meshes
+	bool bMaterialCreatedOnLoad = false;
+
+	UMaterialInterface* CreateRegularTerrainMaterial(uint16 MaterialId);
+
+	UMaterialInterface* CreateTransitionMaterial(uint64 Code, const std::set<unsigned short>& MaterialIdSet);
+
+	void PrepareTerrainMaterials();
+
+	void CreatePendingTransitionMaterials();
+
 	//===============================================================================
 	// 
 	//===============================================================================
@@ -656,6 +893,109 @@ private:
 
 	void CheckUnreachableZones(const TArray<FVector>& PlayerLocationList);
 
+	bool CheckZoneCanHaveGeometry(const TVoxelIndex& Index);
+
+	//===============================================================================
+	// far terrain
+	//===============================================================================
+
+	TMap<TVoxelIndex, UFarTerrainComponent*> FarTerrainMap;
+
+	TMap<TVoxelIndex, std::shared_ptr<TFarTerrainMeshData>> FarTerrainCache;
+
+	TSet<TVoxelIndex> FarTerrainRequired;
+
+	TSet<TVoxelIndex> FarTerrainPending;
+
+	void UpdateFarTerrain(const TArray<FVector>& PlayerLocationList);
+
+	std::shared_ptr<TFarTerrainMeshData> GenerateFarTerrainMesh(const TVoxelIndex& RegionIndex);
+
+	void SpawnFarTerrain(const TVoxelIndex& RegionIndex, std::shared_ptr<TFarTerrainMeshData> MeshDataPtr);
+
+	// player locations of last far terrain update
+	TArray<FVector> FarTerrainFocusList;
+
+	void ClcFarTerrainCoverage(const TVoxelIndex& RegionIndex, const TFarTerrainMeshData& MeshData, TBitArray<>& CoveredCellMask);
+
+	//===============================================================================
+	// zone batching
+	//===============================================================================
+
+	TMap<TVoxelIndex, UTerrainBatchComponent*> ZoneBatchMap;
+
+	// zone grid cells with all zones at batch lod
+	TSet<TVoxelIndex> ZoneBatchRequired;
+
+	TSet<TVoxelIndex> ZoneBatchPending;
+
+	// zones of batched cell changed. stale batch is hidden, zones are drawn until rebuilt. value: time of first change
+	TMap<TVoxelIndex, double> ZoneBatchDirty;
+
+	// batch spawned, zones are still drawn. value: frame of spawn
+	TMap<TVoxelIndex, uint64> ZoneBatchSwap;
+
+	void UpdateZoneBatches();
+
+	void StartZoneBatchBuild(const TVoxelIndex& Cell, const std::unordered_set<TVoxelIndex>& ZoneSet);
+
+	std::shared_ptr<TZoneBatchMeshData> BuildZoneBatchMesh(const TVoxelIndex& Cell, const TArray<TZoneBatchItem>& ZoneList);
+
+	void SpawnZoneBatch(const TVoxelIndex& Cell, std::shared_ptr<TZoneBatchMeshData> MeshDataPtr);
+
+	void RemoveZoneBatch(const TVoxelIndex& Cell);
+
+	void SetZoneBatchHidden(const TVoxelIndex& Cell, const bool bHidden);
+
+	// hides zones of spawned batch when its proxy exists
+	void UpdateZoneBatchSwap();
+
+	// zone mesh applied, zone lod state changed or zone unloaded
+	void MarkZoneBatchDirty(const TVoxelIndex& ZoneIndex);
+
+	//===============================================================================
+	// zone lod state
+	//===============================================================================
+
+	// views of local players used for last lod update: xyz position, w screen multiple. empty: not updated yet
+	TArray<FVector4> ZoneLodViewList;
+
+	void UpdateZoneLods();
+
+	int32 ClcZoneLod(const FVector& ZonePos) const;
+
+	void ApplyZoneLodState(const TVoxelIndex& ZoneIndex, UVoxelMeshComponent* MeshComponent);
+
+	//===============================================================================
+	// zone occlusion
+	//===============================================================================
+
+	TSet<TVoxelIndex> OccludedZoneSet;
+
+	TVoxelIndex ZoneOcclusionViewZone;
+
+	double ZoneOcclusionTime = 0;
+
+	// zone mesh applied or zone solid state changed
+	bool bZoneOcclusionDirty = true;
+
+	void UpdateZoneOcclusion();
+
+	void ApplyZoneOcclusion(const TVoxelIndex& ZoneIndex, UVoxelMeshComponent* MeshComponent);
+
+	//===============================================================================
+	// zone collision lod
+	//===============================================================================
+
+	// players, ai pawns, simulating physics objects and anchor objects of last area check
+	TArray<FVector> CollisionFocusList;
+
+	void UpdateZoneCollisionLods(const TArray<FVector>& PlayerLocationList);
+
+	int32 ClcZoneCollisionLod(const TVoxelIndex& ZoneIndex, const int32 CurrentLod);
+
+	void ApplyZoneCollisionLod(const TVoxelIndex& ZoneIndex, UVoxelMeshComponent* MeshComponent);
+
 	//===============================================================================
 	// network
 	//===============================================================================
@@ -718,7 +1058,7 @@ protected:
 
 	void MarkZoneNeedsToSaveObjects(const TVoxelIndex& ZoneIndex);
 
-	void ZoneHardUnload(UTerrainZoneComponent* ZoneComponent, const TVoxelIndex& ZoneIndex);
+	bool ZoneHardUnload(UTerrainZoneComponent* ZoneComponent, const TVoxelIndex& ZoneIndex);
 
 	void ZoneSoftUnload(UTerrainZoneComponent* ZoneComponent, const TVoxelIndex& ZoneIndex);
 
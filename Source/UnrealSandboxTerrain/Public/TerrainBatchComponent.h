@@ -0,0 +1,47 @@
+// Copyright blackw 2015-2020
+
+#pragma once
+
+#include "EngineMinimal.h"
+#include "Components/MeshComponent.h"
+#include "VoxelMeshData.h"
+#include "TerrainBatchComponent.generated.h"
+
+
+/**
+* distant zones of one zone grid cell drawn as one primitive instead of zone meshes
+*/
+UCLASS()
+class UNREALSANDBOXTERRAIN_API UTerrainBatchComponent : public UMeshComponent {
+	GENERATED_UCLASS_BODY()
+
+public:
+
+	TVoxelIndex CellIndex;
+
+	void SetBatchMeshData(TZoneBatchMeshDataPtr NewMeshDataPtr, const TArray<UMaterialInterface*>& Materials);
+
+	//~ Begin UPrimitiveComponent Interface.
+	virtual FPrimitiveSceneProxy* CreateSceneProxy() override;
+	//~ End UPrimitiveComponent Interface.
+
+	//~ Begin UMeshComponent Interface.
+	virtual int32 GetNumMaterials() const override;
+	//~ End UMeshComponent Interface.
+
+	virtual void GetUsedMaterials(TArray<UMaterialInterface*>& OutMaterials, bool bGetDebugMaterials = false) const override;
+
+private:
+
+	//~ Begin USceneComponent Interface.
+	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+	//~ Begin USceneComponent Interface.
+
+	TZoneBatchMeshDataPtr MeshDataPtr;
+
+	// per section of mesh data
+	UPROPERTY()
+	TArray<UMaterialInterface*> SectionMaterials;
+
+	friend class FTerrainBatchSceneProxy;
+};
@@ -0,0 +1,63 @@
+// Copyright blackw 2015-2020
+
+#pragma once
+
+#include "EngineMinimal.h"
+#include "Components/PrimitiveComponent.h"
+#include "Interfaces/Interface_CollisionDataProvider.h"
+#include "VoxelMeshData.h"
+#include "TerrainCollisionChunkComponent.generated.h"
+
+
+/**
+* part of zone collision mesh. cooked separately, so edit of zone cooks again only changed chunks
+*/
+UCLASS()
+class UNREALSANDBOXTERRAIN_API UTerrainCollisionChunkComponent : public UPrimitiveComponent, public IInterface_CollisionDataProvider {
+	GENERATED_UCLASS_BODY()
+
+public:
+
+	int32 ChunkIndex = 0;
+
+	// game thread. cooks new collision
+	void SetChunkData(const TCollisionChunkData& NewChunkData);
+
+	uint32 GetChunkHash() const;
+
+	TMaterialId GetMaterialIdFromCollisionFaceIndex(int32 FaceIndex) const;
+
+	void GetMaterialIdsFromCollisionFaceIndices(const TArray<int32>& FaceIndexArray, TArray<TMaterialId>& OutMaterialIdArray) const;
+
+	//~ Begin UPrimitiveComponent Interface.
+	virtual class UBodySetup* GetBodySetup() override;
+	//~ End UPrimitiveComponent Interface.
+
+	//~ Begin Interface_CollisionDataProvider Interface
+	virtual bool GetPhysicsTriMeshData(struct FTriMeshCollisionData* CollisionData, bool InUseAllTriData) override;
+	virtual bool ContainsPhysicsTriMeshData(bool InUseAllTriData) const override;
+	virtual bool WantsNegXTriMesh() override { return false; }
+	//~ End Interface_CollisionDataProvider Interface
+
+private:
+
+	//~ Begin USceneComponent Interface.
+	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+	//~ Begin USceneComponent Interface.
+
+	TCollisionChunkData ChunkData;
+
+	FBox LocalBox;
+
+	UPROPERTY(Instanced)
+	class UBodySetup* ChunkBodySetup;
+
+	UPROPERTY(transient)
+	TArray<UBodySetup*> AsyncBodySetupQueue;
+
+	UBodySetup* CreateBodySetupHelper();
+
+	void FinishPhysicsAsyncCook(bool bSuccess, UBodySetup* FinishedBodySetup);
+
+	void UpdateCollision();
+};
@@ -93,6 +93,9 @@ struct TZoneStructureHandler {
 	FVector Pos;
 	float Val1;
 	float Val2;
+
+	// world space area affected by Function. invalid box means whole zone
+	FBox Bounds = FBox(ForceInit);
 };
 
 struct TInstanceMeshSpawnParams {
@@ -165,6 +168,8 @@ class UNREALSANDBOXTERRAIN_API UTerrainGeneratorComponent : public UActorCompone
 
 	friend TStructuresGenerator;
 
+	friend class FTerrainGeneratorMaterialLayerTest;
+
 public:
 		
 	UPROPERTY()
@@ -190,6 +195,9 @@ public:
 
 	void ForceGenerateZone(TVoxelData* VoxelData, const TVoxelIndex& ZoneIndex);
 
+	// generation type by chunk height map only. voxel data is not generated
+	TZoneGenerationType PredictZoneGenType(const TVoxelIndex& ZoneIndex);
+
 	void BatchGenerateVoxelTerrain(const TArray<TSpawnZoneParam>& GenerationList, TArray<TGenerateZoneResult>& ResultArray);
 
 	virtual float GroundLevelFunction(const TVoxelIndex& Index, const FVector& V) const;
@@ -280,6 +288,12 @@ protected:
 
 	virtual TMaterialId MaterialFuncionExt(const TGenerateVdTempItm* GenItm, const TMaterialId MatId, const FVector& WorldPos, const TVoxelIndex VoxelIndex) const;
 
+	// whole Z column (X, Y) with step S per call. default implementation calls MaterialFuncionExt/DensityFunctionExt per voxel,
+	// override these instead to avoid per voxel virtual calls
+	virtual void MaterialFuncionExtColumn(const TGenerateVdTempItm& Itm, const int X, const int Y, const int S, TMaterialId* MaterialColumn) const;
+
+	virtual void DensityFunctionExtColumn(const TGenerateVdTempItm& Itm, const int X, const int Y, const int S, float* DensityColumn) const;
+
 	virtual TGenerateVdTempItm CollectVdGenerationData(const TVoxelIndex& ZoneIndex);
 
 	virtual void ExtVdGenerationData(TGenerateVdTempItm& VdGenerationData);
@@ -316,6 +330,13 @@ private:
 
 	TArray<FTerrainUndergroundLayer> UndergroundLayersTmp;
 
+	// StartDepth of each underground layer in the same order. used for fast lookup
+	std::vector<float> UndergroundLayerDepthTmp;
+
+	bool bUndergroundLayersSorted = false;
+
+	void PrepareMaterialLayers();
+
 	std::mutex ChunkDataMapMutex;
 
 #ifdef __cpp_lib_atomic_shared_ptr                      
@@ -330,6 +351,8 @@ private:
 
 	float ClcDensityByGroundLevel(const FVector& V, const float GroundLevel) const;
 
+	void ClcDensityColumnByGroundLevel(const float GroundLevel, const float StartZ, const float Step, const int Num, float* OutDensity) const;
+
 	void GenerateZoneVolume(const TGenerateVdTempItm& Itm) const;
 
 	void GenerateZoneVolumeWithFunction(const TGenerateVdTempItm& Itm, const std::vector<TZoneStructureHandler>& StructureList) const;
@@ -342,8 +365,6 @@ private:
 
 	//====
 
-	ResultA A(const TVoxelIndex& ZoneIndex, const TVoxelIndex& VoxelIndex, TVoxelData* VoxelData, const TGenerateVdTempItm& Itm) const;
-
 	float B(const TVoxelIndex& ZoneIndex, const TVoxelIndex& Index, TVoxelData* VoxelData, TConstChunkData ChunkData) const;
 
 	void GenerateLandscapeZoneSlight(const TGenerateVdTempItm& Itm) const;
@@ -80,7 +80,20 @@ public:
 
 	static TDataPtr SerializeInstancedMesh(const TInstanceMeshTypeMap& InstanceMeshMap);
 
+	// clean up before return to zone pool. terrain mesh and instanced mesh components are kept for reuse
+	void ResetForPool();
+
+	void RestoreFromPool();
+
+	bool IsPooled() const;
+
 private:
+
+	bool bPooled = false;
+
+	// detached instanced mesh components of pooled zone
+	UPROPERTY()
+	TMap<uint64, UTerrainInstancedStaticMesh*> IdleInstancedMeshMap;
     
 	double MeshDataTimeStamp;
 
@@ -51,7 +51,12 @@ public:
 
 	void clear();
 
-	void forEach(std::function<void(const TSubstanceCacheItem& itm)> func) const;
+	template<typename F>
+	void forEach(F func) const {
+		for (int i = 0; i < idx; i++) {
+			func(cellArray[i]);
+		}
+	}
 
 	void copy(const int* cache_data, const int len);
 
@@ -149,9 +154,50 @@ public:
 	static TDensityVal clcFloatToByte(float v);
 	static float clcByteToFloat(TDensityVal v);
 
-	void forEach(std::function<void(int x, int y, int z)> func);
-	void forEachWithCache(std::function<void(int x, int y, int z)> func, bool enableLOD);
-	void forEachCacheItem(const int lod, std::function<void(const TSubstanceCacheItem& itm)> func) const;
+	// iteration helpers are templates to let handler be inlined into voxel loop
+	template<typename F>
+	void forEach(F func) {
+		const int n = num();
+		for (int x = 0; x < n; x++)
+			for (int y = 0; y < n; y++)
+				for (int z = 0; z < n; z++)
+					func(x, y, z);
+	}
+
+	// handler process whole Z row per call: func(x, y, n)
+	template<typename F>
+	void forEachRow(F func) {
+		const int n = num();
+		for (int x = 0; x < n; x++)
+			for (int y = 0; y < n; y++)
+				func(x, y, n);
+	}
+
+	template<typename F>
+	void forEachWithCache(F func, bool enableLOD) {
+		clearSubstanceCache();
+		initCache();
+
+		const int n = num();
+		for (int x = 0; x < n; x++) {
+			for (int y = 0; y < n; y++) {
+				for (int z = 0; z < n; z++) {
+					func(x, y, z);
+
+					if (enableLOD) {
+						performSubstanceCacheLOD(x, y, z);
+					} else {
+						performSubstanceCacheNoLOD(x, y, z);
+					}
+				}
+			}
+		}
+	}
+
+	template<typename F>
+	void forEachCacheItem(const int lod, F func) const {
+		substanceCacheLOD[lod].forEach(func);
+	}
 
 	void setDensity(int x, int y, int z, float density);
 	float getDensity(int x, int y, int z) const;
@@ -173,6 +219,9 @@ public:
 	float size() const;
 	int num() const;
 
+	// approximate heap size including substance cache
+	size_t getMemorySize() const;
+
 	FVector voxelIndexToVector(TVoxelIndex Idx) const;
 	FVector voxelIndexToVector(int x, int y, int z) const;
 	void vectorToVoxelIndex(const FVector& v, int& x, int& y, int& z) const;
@@ -1,5 +1,16 @@
 #pragma once
 
+// coordinates mixed by multiply and shift. plain xor collides for symmetric indexes like (a, b, c) and (b, a, c)
+FORCEINLINE uint64 ClcVoxelIndexHash(const int32 X, const int32 Y, const int32 Z) {
+	uint64 H = (uint64)(uint32)X * 0x9E3779B185EBCA87ull;
+	H = (H ^ (H >> 29)) + (uint64)(uint32)Y * 0xC2B2AE3D27D4EB4Full;
+	H = (H ^ (H >> 31)) + (uint64)(uint32)Z * 0x165667B19E3779F9ull;
+	H ^= H >> 33;
+	H *= 0xFF51AFD7ED558CCDull;
+	H ^= H >> 33;
+	return H;
+}
+
 struct TVoxelIndex {
 	int32 X = 0;
 	int32 Y = 0;
@@ -36,7 +47,8 @@ struct TVoxelIndex {
 	}
 
 	friend uint32 GetTypeHash(const TVoxelIndex& Index) {
-		return ((std::hash<int>()(Index.X) ^ (std::hash<int>()(Index.Y) << 1)) >> 1) ^ (std::hash<int>()(Index.Z) << 1);
+		const uint64 H = ClcVoxelIndexHash(Index.X, Index.Y, Index.Z);
+		return (uint32)(H ^ (H >> 32));
 	}
 };
 
@@ -45,7 +57,7 @@ namespace std {
 	template <>
 	struct hash<TVoxelIndex> {
 		std::size_t operator()(const TVoxelIndex& Index) const {
-			return ((std::hash<int>()(Index.X) ^ (std::hash<int>()(Index.Y) << 1)) >> 1) ^ (std::hash<int>()(Index.Z) << 1);
+			return (std::size_t)ClcVoxelIndexHash(Index.X, Index.Y, Index.Z);
 		}
 	};
 }
@@ -11,6 +11,8 @@
 
 typedef std::shared_ptr<TMeshData> TMeshDataPtr;
 
+class UTerrainCollisionChunkComponent;
+
 /**
 *
 */
@@ -26,6 +28,10 @@ public:
 
 	void SetMeshData(TMeshDataPtr MeshDataPtr);
 
+	void ClearMeshData();
+
+	TMeshDataPtr GetMeshData() const;
+
 	//~ Begin UPrimitiveComponent Interface.
 	virtual FPrimitiveSceneProxy* CreateSceneProxy() override;
 	virtual class UBodySetup* GetBodySetup() override;
@@ -41,6 +47,28 @@ public:
 
 	bool bLodFlag;
 
+	// lod and transition patches selected by controller. proxy draws this lod from cached static draw commands, patches dynamic.
+	// -1: lod by screen size, patches are selected per frame
+	int32 FixedLodIndex = -1;
+
+	// bit per neighbor direction (-X, +X, -Y, +Y, -Z, +Z) which has finer lod
+	uint8 TransitionPatchMask = 0;
+
+	// game thread. pushed to existing proxy, no render state recreation
+	void SetLodState(const int32 LodIndex, const uint8 PatchMask);
+
+	// zone can't be seen from view zone, set by controller. mesh is kept, only drawing is skipped
+	bool bOccluded = false;
+
+	// game thread. no render state recreation
+	void SetOccluded(const bool bNewOccluded);
+
+	// zone is drawn by batch of its zone grid cell, set by controller. mesh is kept, drawing and shadow are skipped
+	bool bBatched = false;
+
+	// game thread. no render state recreation
+	void SetBatched(const bool bNewBatched);
+
 	virtual void GetUsedMaterials(TArray<UMaterialInterface*>& OutMaterials, bool bGetDebugMaterials = false) const override;
 
 	// ======================================================================
@@ -61,10 +89,22 @@ public:
 
 	void SetCollisionMeshData(TMeshDataPtr MeshDataPtr);
 
+	// collision is cooked again only if lod changed. -1 - no collision
+	void SetCollisionLod(const int32 LodIndex);
+
+	int32 GetCollisionLod() const;
+
+	// copy collision profile to collision chunks
+	void SyncCollisionChunkSettings();
+
 	void AddCollisionConvexMesh(TArray<FVector> ConvexVerts);
 
+	// face index of hit result, O(log n) by face range table of cooked collision
 	TMaterialId GetMaterialIdFromCollisionFaceIndex(int32 FaceIndex) const;
 
+	// many hits at once. unknown face gets 0
+	void GetMaterialIdsFromCollisionFaceIndices(const TArray<int32>& FaceIndexArray, TArray<TMaterialId>& OutMaterialIdArray) const;
+
 private:
 
 	//~ Begin USceneComponent Interface.
@@ -73,8 +113,8 @@ private:
 
 	void UpdateLocalBounds();
 
-	/** Array of sections of mesh */
-	TArray<TMeshLodSection> MeshSectionLodArray;
+	/** Mesh data with prepared render sections. shared with controller cache and scene proxy */
+	TMeshDataPtr MeshDataPtr;
 
 	/** Local space bounds of mesh */
 	UPROPERTY()
@@ -84,6 +124,8 @@ private:
 
 	friend class FVoxelMeshSceneProxy;
 
+	friend class FVoxelMeshCollisionFaceMaterialTest;
+
 	UPROPERTY(transient)
 	TArray<UBodySetup*> AsyncBodySetupQueue;
 
@@ -99,7 +141,28 @@ private:
 	void AddCollisionSection(struct FTriMeshCollisionData* CollisionData, const FProcMeshSection& MeshSection, const int32 MatId, const int32 VertexBase);
 
 	//FProcMeshSection TriMeshData;
-	TMeshLodSection CollisionLodSection;
+	TMeshDataPtr CollisionMeshDataPtr;
+
+	int32 CollisionLodIndex = 0;
+
+	// end face (exclusive) and material of each face range, same face order as GetPhysicsTriMeshData
+	TArray<int32> CollisionFaceRangeEnd;
+
+	TArray<TMaterialId> CollisionFaceRangeMaterial;
+
+	void BuildCollisionFaceMaterialTable();
+
+	// collision split to chunks, see ASandboxTerrainController::CollisionChunkSplit
+	UPROPERTY(transient)
+	TArray<UTerrainCollisionChunkComponent*> CollisionChunkArray;
+
+	int32 GetCollisionChunkSplit() const;
+
+	void UpdateCollisionChunks(const int32 Split);
+
+	UTerrainCollisionChunkComponent* CreateCollisionChunk(const int32 ChunkIdx);
+
+	const TMeshLodSection* GetCollisionLodSection() const;
 
 	void CreateProcMeshBodySetup();
 
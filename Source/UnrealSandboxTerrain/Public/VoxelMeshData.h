@@ -1,6 +1,8 @@
 #pragma once
 
 #include "EngineMinimal.h"
+#include "PackedNormal.h"
+#include "Interfaces/Interface_CollisionDataProvider.h"
 #include "VoxelData.h"
 #include "Mesh.h"
 
@@ -22,6 +24,52 @@ union TTransitionMaterialCode {
 	uint64 Code;
 };
 
+#if ENGINE_MAJOR_VERSION == 5
+typedef FVector3f TPackedVertexVector;
+typedef FVector4f TPackedVertexVector4;
+#else
+typedef FVector TPackedVertexVector;
+typedef FVector4 TPackedVertexVector4;
+#endif
+
+// mesh section in render buffer layout. built once on worker thread and kept with mesh data, copied to scene proxy buffers
+typedef struct TMeshRenderSection {
+
+	TArray<TPackedVertexVector> Positions;
+
+	// low precision tangent basis. TangentX and TangentZ per vertex
+	TArray<FPackedNormal> Tangents;
+
+	// transition material weight
+	TArray<FColor> Colors;
+
+	// NumTexCoords uv per vertex. empty - one zero uv
+	TArray<FVector2DHalf> TexCoords;
+
+	TArray<uint32> Indices;
+
+	int32 NumVertices() const {
+		return Positions.Num();
+	}
+
+	int32 NumTexCoords() const {
+		return (Positions.Num() > 0 && TexCoords.Num() > 0) ? TexCoords.Num() / Positions.Num() : 1;
+	}
+
+	SIZE_T GetAllocatedSize() const {
+		return sizeof(TMeshRenderSection) + Positions.GetAllocatedSize() + Tangents.GetAllocatedSize() + Colors.GetAllocatedSize() + TexCoords.GetAllocatedSize() + Indices.GetAllocatedSize();
+	}
+
+} TMeshRenderSection;
+
+typedef std::shared_ptr<const TMeshRenderSection> TMeshRenderSectionPtr;
+
+// any thread
+TMeshRenderSectionPtr BuildMeshRenderSection(const FProcMeshSection& Section);
+
+// append vertexes and indexes of source section moved by offset
+void AppendMeshRenderSection(TMeshRenderSection& Target, const TMeshRenderSection& Source, const TPackedVertexVector& Offset);
+
 // mesh per one material
 typedef struct TMeshMaterialSection {
 
@@ -31,6 +79,8 @@ typedef struct TMeshMaterialSection {
 
 	int32 vertexIndexCounter = 0;
 
+	TMeshRenderSectionPtr RenderSection = nullptr;
+
 } TMeshMaterialSection;
 
 typedef struct TMeshMaterialTransitionSection : TMeshMaterialSection {
@@ -65,11 +115,45 @@ typedef struct TMeshContainer {
 
 	TMaterialTransitionSectionMap MaterialTransitionSectionMap; // materials with blending
 
+	TMeshRenderSectionPtr MergedRenderSection = nullptr; // all materials in one section, material id per vertex
+
+	SIZE_T GetAllocatedSize() const {
+		SIZE_T Size = MergedRenderSection ? MergedRenderSection->GetAllocatedSize() : 0;
+		for (const auto& Elem : MaterialSectionMap) {
+			Size += Elem.Value.MaterialMesh.GetAllocatedSize();
+			Size += Elem.Value.RenderSection ? Elem.Value.RenderSection->GetAllocatedSize() : 0;
+		}
+
+		for (const auto& Elem : MaterialTransitionSectionMap) {
+			Size += Elem.Value.MaterialMesh.GetAllocatedSize();
+			Size += Elem.Value.RenderSection ? Elem.Value.RenderSection->GetAllocatedSize() : 0;
+		}
+
+		return Size;
+	}
+
+	void AddToBox(FBox& Box) const {
+		for (const auto& Elem : MaterialSectionMap) {
+			if (Elem.Value.MaterialMesh.SectionLocalBox.IsValid) {
+				Box += Elem.Value.MaterialMesh.SectionLocalBox;
+			}
+		}
+
+		for (const auto& Elem : MaterialTransitionSectionMap) {
+			if (Elem.Value.MaterialMesh.SectionLocalBox.IsValid) {
+				Box += Elem.Value.MaterialMesh.SectionLocalBox;
+			}
+		}
+	}
+
 } TMeshContainer;
 
+// any thread
+TMeshRenderSectionPtr BuildMergedMeshRenderSection(const TMeshContainer& MeshContainer);
+
 typedef struct TMeshLodSection {
 
-	FProcMeshSection WholeMesh; // whole mesh (collision only)
+	FProcMeshSection WholeMesh; // whole mesh without materials. not used at runtime, emptied when render sections are built
 
 	TMeshContainer RegularMeshContainer; // used only for render main mesh
 
@@ -83,6 +167,25 @@ typedef struct TMeshLodSection {
 
 } TMeshLodSection;
 
+// triangles of one collision chunk in zone local space
+typedef struct TCollisionChunkData {
+
+	TArray<TPackedVertexVector> Vertices;
+
+	TArray<FTriIndices> Indices;
+
+	// material per face
+	TArray<TMaterialId> MaterialIds;
+
+	// crc of vertices, indices and materials. 0 - empty chunk
+	uint32 Hash = 0;
+
+	SIZE_T GetAllocatedSize() const {
+		return Vertices.GetAllocatedSize() + Indices.GetAllocatedSize() + MaterialIds.GetAllocatedSize();
+	}
+
+} TCollisionChunkData;
+
 
 typedef struct TMeshData {
 	TArray<TMeshLodSection> MeshSectionLodArray;
@@ -95,6 +198,7 @@ typedef struct TMeshData {
 
 	TMeshData() {
 		MeshSectionLodArray.SetNum(LOD_ARRAY_SIZE); 
+		CollisionChunkLodArray.SetNum(LOD_ARRAY_SIZE);
 		CollisionMeshPtr = nullptr;
 		md_counter++;
 	}
@@ -103,10 +207,158 @@ typedef struct TMeshData {
 		md_counter--;
 	}
 
+	// approximate heap size of mesh buffers
+	SIZE_T GetAllocatedSize() const {
+		const std::lock_guard<std::mutex> Lock(RenderDataMutex);
+		SIZE_T Size = sizeof(TMeshData);
+		for (const auto& LodSection : MeshSectionLodArray) {
+			Size += LodSection.WholeMesh.GetAllocatedSize();
+			Size += LodSection.RegularMeshContainer.GetAllocatedSize();
+			for (const auto& Patch : LodSection.TransitionPatchArray) {
+				Size += Patch.GetAllocatedSize();
+			}
+		}
+
+		for (const auto& ChunkDataArray : CollisionChunkLodArray) {
+			for (const auto& ChunkData : ChunkDataArray) {
+				Size += ChunkData.GetAllocatedSize();
+			}
+		}
+
+		return Size;
+	}
+
+	// local box of render mesh of all lods and patches. invalid if no mesh
+	FBox GetLocalBox() const {
+		FBox Box(EForceInit::ForceInit);
+		for (const auto& LodSection : MeshSectionLodArray) {
+			LodSection.RegularMeshContainer.AddToBox(Box);
+			for (const auto& Patch : LodSection.TransitionPatchArray) {
+				Patch.AddToBox(Box);
+			}
+		}
+
+		return Box;
+	}
+
+	// build render sections of all lods and patches. any thread, does nothing if already built
+	void PrepareRenderData(const bool bMergeMaterials = false);
+
+	// build render sections if not built yet and read them
+	template<typename Function>
+	void ReadRenderData(const bool bMergeMaterials, Function Fn) {
+		const std::lock_guard<std::mutex> Lock(RenderDataMutex);
+		PrepareRenderDataInternal(bMergeMaterials);
+		Fn();
+	}
+
+	// nearest lod with mesh. zone without lod generation has only lod 0. -1 - no collision
+	int32 GetCollisionLodIndex(const int32 LodIndex) const;
+
+	// bucket collision lod to Split x Split x Split chunks with crc. any thread, does nothing if already built
+	void PrepareCollisionChunks(const int32 Split, const int32 LodIndex);
+
+	// build collision chunks if not built yet and read them. no collision gives empty chunks
+	template<typename Function>
+	void ReadCollisionChunks(const int32 Split, const int32 LodIndex, Function Fn) {
+		const std::lock_guard<std::mutex> Lock(RenderDataMutex);
+		const int32 CollisionLod = GetCollisionLodIndex(LodIndex);
+		if (CollisionLod < 0) {
+			TArray<TCollisionChunkData> EmptyChunkArray;
+			EmptyChunkArray.SetNum(Split * Split * Split);
+			Fn(EmptyChunkArray);
+			return;
+		}
+
+		PrepareCollisionChunksInternal(Split, CollisionLod);
+		Fn(CollisionChunkLodArray[CollisionLod]);
+	}
+
+private:
+
+	void PrepareRenderDataInternal(const bool bMergeMaterials);
+
+	void PrepareCollisionChunksInternal(const int32 Split, const int32 LodIndex);
+
+	// chunks per collision lod. empty - not built
+	TArray<TArray<TCollisionChunkData>> CollisionChunkLodArray;
+
+	int32 CollisionChunkSplit = 0;
+
+	mutable std::mutex RenderDataMutex;
+
+	bool bRenderDataReady = false;
+
 } TMeshData;
 
 typedef std::shared_ptr<TMeshData> TMeshDataPtr;
 
+// coarse height field mesh of whole region. index buffer is ordered by cells,
+// so visible cells can be drawn as few index ranges
+typedef struct TFarTerrainMeshData {
+
+	FProcMeshSection Mesh;
+
+	// first index of each cell in Mesh.ProcIndexBuffer. last element is total index count
+	TArray<uint32> CellFirstIndex;
+
+	// local space box of each cell
+	TArray<FBox> CellBox;
+
+	// cells per side
+	int32 CellNum = 0;
+
+	unsigned short MaterialId = 0;
+
+	TMeshRenderSectionPtr RenderSection = nullptr;
+
+	SIZE_T GetAllocatedSize() const {
+		return sizeof(TFarTerrainMeshData) + Mesh.GetAllocatedSize() + CellFirstIndex.GetAllocatedSize() + CellBox.GetAllocatedSize() + (RenderSection ? RenderSection->GetAllocatedSize() : 0);
+	}
+
+} TFarTerrainMeshData;
+
+typedef std::shared_ptr<TFarTerrainMeshData> TFarTerrainMeshDataPtr;
+
+// one material of combined zones mesh
+typedef struct TZoneBatchSection {
+
+	TMeshRenderSectionPtr RenderSection = nullptr;
+
+	bool bMerged = false; // merged lod section, all materials
+
+	bool bTransition = false;
+
+	unsigned short MaterialId = 0;
+
+	std::set<unsigned short> MaterialIdSet;
+
+} TZoneBatchSection;
+
+// distant zones of one zone grid cell combined to one primitive
+typedef struct TZoneBatchMeshData {
+
+	TArray<TZoneBatchSection> SectionArray;
+
+	FBox LocalBox;
+
+	int32 ZoneCount = 0;
+
+	TZoneBatchMeshData() : LocalBox(EForceInit::ForceInit) { }
+
+	SIZE_T GetAllocatedSize() const {
+		SIZE_T Size = sizeof(TZoneBatchMeshData) + SectionArray.GetAllocatedSize();
+		for (const auto& Section : SectionArray) {
+			Size += Section.RenderSection ? Section.RenderSection->GetAllocatedSize() : 0;
+		}
+
+		return Size;
+	}
+
+} TZoneBatchMeshData;
+
+typedef std::shared_ptr<TZoneBatchMeshData> TZoneBatchMeshDataPtr;
+
 typedef struct TVoxelDataParam {
 
 	bool bGenerateLOD = false;